@@ -55,6 +55,13 @@ namespace mp{
 		weightH = 200;
 
 		sequencePath = Config.GetSequencePath(clipEntry);
+		maskArchive.Close();
+		if (Config.CachedImageType == "rle" && !maskArchive.Open(Config.GetMaskArchivePath(clipEntry)))
+		{
+			cerr << "Unable to open mask archive: " << Config.GetMaskArchivePath(clipEntry) << endl;
+			cerr << "Press ENTER to exit." << endl; cin.get();
+			exit(EXIT_FAILURE);
+		}
 		initWeight();
 		initSequence();
 
@@ -297,21 +304,33 @@ namespace mp{
 
 
         // read mask
-		
-        auto foregroundFolder = Config.GetForegroundFolder(*clipEntry);
-        //auto foregroundPath = foregroundFolder + "/" + clipMaskFileNames[iFrame];
-		char tmp[10];
-		sprintf(tmp,"%d.bmp",iFrame);
-		string tmps(tmp);
-		auto foregroundPath = foregroundFolder + "/" + tmps;
-		Mat fg = imread(foregroundPath, CV_LOAD_IMAGE_COLOR);
+		Mat fg, mask;
+		if (maskArchive.IsOpen())
+		{
+			if (!maskArchive.ReadFrame(iFrame, fg, mask))
+			{
+				cerr << "Unable to read masks of frame #" << iFrame << " from archive." << endl;
+				mask = Mat::zeros(frame.rows, frame.cols, CV_8UC3);
+				fg = Mat::zeros(frame.rows, frame.cols, CV_8U);
+			}
+		}
+		else
+		{
+			auto foregroundFolder = Config.GetForegroundFolder(*clipEntry);
+			//auto foregroundPath = foregroundFolder + "/" + clipMaskFileNames[iFrame];
+			char tmp[10];
+			sprintf(tmp,"%d.bmp",iFrame);
+			string tmps(tmp);
+			auto foregroundPath = foregroundFolder + "/" + tmps;
+			fg = imread(foregroundPath, CV_LOAD_IMAGE_COLOR);
 		
 
-		auto maskFolder = Config.GetMaskFolder(*clipEntry);
-		sprintf(tmp,"%d.bmp",iFrame);
-		tmps.assign(tmp);
-		auto maskPath = maskFolder + "/" + tmps;
-		Mat mask = imread(maskPath, CV_LOAD_IMAGE_COLOR);
+			auto maskFolder = Config.GetMaskFolder(*clipEntry);
+			sprintf(tmp,"%d.bmp",iFrame);
+			tmps.assign(tmp);
+			auto maskPath = maskFolder + "/" + tmps;
+			mask = imread(maskPath, CV_LOAD_IMAGE_COLOR);
+		}
 
         // substitute mask in frame
 		
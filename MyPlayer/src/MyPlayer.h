@@ -36,6 +36,9 @@ namespace mp{
 		IplImage *imgWeight;
 		IplImage *imgWeightShow;
 
+		/// masks of the current clip, if they have been archived (cachedImageType "rle")
+		SmartVideo::MaskArchiveReader maskArchive;
+
 		Player(PlayerConfig cfg) :
             Config(cfg)
         {
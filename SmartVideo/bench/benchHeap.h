@@ -0,0 +1,43 @@
+#ifndef BENCHHEAP_H
+#define BENCHHEAP_H
+
+/// Heap usage of a benchmark: all operator new calls of the process go through here.
+/// Replaces the global operator new and delete, so include it in exactly one translation unit per benchmark.
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    // allocation size is stored in front of every block
+    const size_t HeaderSize = 16;
+
+    std::atomic<long long> heapUsed(0);
+    std::atomic<long long> heapPeak(0);
+
+    void* TrackedAlloc(size_t size)
+    {
+        char* p = static_cast<char*>(malloc(size + HeaderSize));
+        if (!p) throw std::bad_alloc();
+        *reinterpret_cast<size_t*>(p) = size;
+
+        long long used = heapUsed += size;
+        long long peak = heapPeak;
+        while (used > peak && !heapPeak.compare_exchange_weak(peak, used)) {}
+        return p + HeaderSize;
+    }
+
+    void TrackedFree(void* ptr)
+    {
+        if (!ptr) return;
+        char* p = static_cast<char*>(ptr) - HeaderSize;
+        heapUsed -= *reinterpret_cast<size_t*>(p);
+        free(p);
+    }
+}
+
+void* operator new(size_t size) { return TrackedAlloc(size); }
+void operator delete(void* ptr) throw() { TrackedFree(ptr); }
+
+#endif // BENCHHEAP_H
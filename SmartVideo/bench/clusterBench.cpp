@@ -0,0 +1,391 @@
+/// Micro-benchmark of the clustering engines, on synthetic foreground masks (no OpenCV, no clips needed).
+///
+/// Every frame contains a few filled discs ("blobs") that move across the mask, plus uniform salt noise.
+/// All engines run on the same frames, and are compared against the reference clustering
+/// (brute force for small frames, the exact grid clustering otherwise).
+///
+/// The defaults keep most blobs apart: salt noise much denser than one pixel per dthreshold^2 chains all blobs into one cluster,
+/// and then the reference says little about the engines (a warning is printed, if there are far fewer clusters than blobs).
+///
+/// Usage: clusterBench [--width 960] [--height 720] [--frames 100] [--blobs 8] [--blobSize 40] [--noise 0.0001]
+///                     [--dthreshold 30] [--cthreshold 64] [--threads 0] [--maxPoints 5000] [--bruteLimit 5000] [--seed 1]
+
+#include "agglomerative.h"
+#include "runClustering.h"
+#include "incrementalClustering.h"
+#include "Workers.h"
+#include "benchHeap.h"
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+
+using namespace std;
+using namespace Agglomerative;
+
+
+// ###################################################################################################
+// Synthetic frames
+
+struct BenchConfig
+{
+    int Width, Height;
+    int FrameCount;
+    int BlobCount;
+    int BlobSize;
+    double NoiseDensity;
+    double DThreshold;
+    int CThreshold;
+    int NThreads;
+    int MaxPoints;
+    int BruteLimit;
+    unsigned int Seed;
+
+    BenchConfig() :
+        Width(960), Height(720),
+        FrameCount(100),
+        BlobCount(8),
+        BlobSize(40),
+        NoiseDensity(0.0001),
+        DThreshold(30.0),
+        CThreshold(64),
+        NThreads(0),
+        MaxPoints(5000),
+        BruteLimit(5000),
+        Seed(1)
+    {
+    }
+
+    bool Parse(int argc, char* argv[])
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            string key = argv[i];
+            if (i + 1 >= argc) return false;
+            const char* value = argv[++i];
+            if (key == "--width") Width = atoi(value);
+            else if (key == "--height") Height = atoi(value);
+            else if (key == "--frames") FrameCount = atoi(value);
+            else if (key == "--blobs") BlobCount = atoi(value);
+            else if (key == "--blobSize") BlobSize = atoi(value);
+            else if (key == "--noise") NoiseDensity = atof(value);
+            else if (key == "--dthreshold") DThreshold = atof(value);
+            else if (key == "--cthreshold") CThreshold = atoi(value);
+            else if (key == "--threads") NThreads = atoi(value);
+            else if (key == "--maxPoints") MaxPoints = atoi(value);
+            else if (key == "--bruteLimit") BruteLimit = atoi(value);
+            else if (key == "--seed") Seed = static_cast<unsigned int>(atoi(value));
+            else return false;
+        }
+        return Width > 0 && Height > 0 && FrameCount > 0;
+    }
+};
+
+/// Binary mask (rows = Height, cols = Width), and its foreground pixels in row-major order,
+/// with x = row and y = column (the same layout ObjectTracking gets from findNonZero).
+struct Frame
+{
+    int rows, cols;
+    vector<unsigned char> mask;
+    vector<Point2D> pts;
+};
+
+struct Blob
+{
+    double x, y, vx, vy, radius;
+};
+
+class FrameGenerator
+{
+    const BenchConfig& cfg;
+    std::mt19937 rng;
+    vector<Blob> blobs;
+
+    double Uniform(double lo, double hi)
+    {
+        return std::uniform_real_distribution<double>(lo, hi)(rng);
+    }
+
+public:
+    FrameGenerator(const BenchConfig& cfg) : cfg(cfg), rng(cfg.Seed)
+    {
+        for (int i = 0; i < cfg.BlobCount; ++i)
+        {
+            Blob b;
+            b.radius = cfg.BlobSize * Uniform(0.25, 0.75);
+            b.x = Uniform(0, cfg.Height);
+            b.y = Uniform(0, cfg.Width);
+            b.vx = Uniform(-3, 3);
+            b.vy = Uniform(-3, 3);
+            blobs.push_back(b);
+        }
+    }
+
+    void Next(Frame& frame)
+    {
+        frame.rows = cfg.Height;
+        frame.cols = cfg.Width;
+        frame.mask.assign(frame.rows * frame.cols, 0);
+
+        for (auto& b : blobs)
+        {
+            // bounce off the borders
+            b.x += b.vx;
+            b.y += b.vy;
+            if (b.x < 0 || b.x >= frame.rows) b.vx = -b.vx;
+            if (b.y < 0 || b.y >= frame.cols) b.vy = -b.vy;
+
+            int x1 = max(0, static_cast<int>(b.x - b.radius)), x2 = min(frame.rows - 1, static_cast<int>(b.x + b.radius));
+            int y1 = max(0, static_cast<int>(b.y - b.radius)), y2 = min(frame.cols - 1, static_cast<int>(b.y + b.radius));
+            for (int x = x1; x <= x2; ++x)
+            {
+                for (int y = y1; y <= y2; ++y)
+                {
+                    if ((x - b.x) * (x - b.x) + (y - b.y) * (y - b.y) <= b.radius * b.radius)
+                    {
+                        frame.mask[x * frame.cols + y] = 255;
+                    }
+                }
+            }
+        }
+
+        if (cfg.NoiseDensity > 0)
+        {
+            // skip ahead geometrically instead of drawing for every pixel
+            std::geometric_distribution<int> gap(min(cfg.NoiseDensity, 1.0));
+            for (size_t i = gap(rng); i < frame.mask.size(); i += gap(rng) + 1)
+            {
+                frame.mask[i] = 255;
+            }
+        }
+
+        frame.pts.clear();
+        for (int x = 0; x < frame.rows; ++x)
+        {
+            for (int y = 0; y < frame.cols; ++y)
+            {
+                if (frame.mask[x * frame.cols + y]) frame.pts.push_back(Point2D(x, y));
+            }
+        }
+    }
+};
+
+
+// ###################################################################################################
+// Engines
+
+/// Cluster id of every pixel of a frame (-1 for background and noise).
+typedef vector<int> Labels;
+
+void LabelsFromResults(const Frame& frame, const vector<Result>& results, Labels& labels)
+{
+    labels.assign(frame.rows * frame.cols, -1);
+    for (auto& r : results)
+    {
+        labels[r.pt.x * frame.cols + r.pt.y] = r.id;
+    }
+}
+
+/// One clustering implementation. Run() is timed, Label() is not.
+struct Engine
+{
+    string Name;
+    std::function<void(const Frame&)> Run;
+    std::function<void(const Frame&, Labels&)> Label;
+
+    // totals
+    double Seconds;
+    long long PeakBytes;
+    long long Points;
+    long long Clusters;
+    int FramesRun;
+    int FramesMatched;
+
+    Engine(const string& name) : Name(name), Seconds(0), PeakBytes(0), Points(0), Clusters(0), FramesRun(0), FramesMatched(0) {}
+};
+
+/// Whether both labelings group the same pixels the same way (cluster ids may differ).
+bool IsSamePartition(const Labels& a, const Labels& b)
+{
+    map<int, int> ab, ba;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if ((a[i] < 0) != (b[i] < 0)) return false;
+        if (a[i] < 0) continue;
+        auto fa = ab.insert(make_pair(a[i], b[i]));
+        auto fb = ba.insert(make_pair(b[i], a[i]));
+        if (fa.first->second != b[i] || fb.first->second != a[i]) return false;
+    }
+    return true;
+}
+
+int CountClusters(const Labels& labels)
+{
+    int n = 0;
+    for (auto id : labels) n = max(n, id + 1);
+    return n;
+}
+
+
+// ###################################################################################################
+// main
+
+int main(int argc, char* argv[])
+{
+    BenchConfig cfg;
+    if (!cfg.Parse(argc, argv))
+    {
+        cerr << "Usage: clusterBench [--width n] [--height n] [--frames n] [--blobs n] [--blobSize n] [--noise density]" << endl;
+        cerr << "                    [--dthreshold d] [--cthreshold c] [--threads n] [--maxPoints n] [--bruteLimit n] [--seed n]" << endl;
+        return EXIT_FAILURE;
+    }
+
+    Util::WorkerPool pool(cfg.NThreads);
+    RunLengthClustering runClustering;
+    IncrementalClustering incrementalClustering;
+    vector<Result> results;
+
+    vector<Engine> engines;
+    {
+        Engine e("brute force");
+        e.Run = [&](const Frame& f) { results = AgglomerativeClustering(f.pts).clusterBruteForce(cfg.DThreshold, cfg.CThreshold); };
+        e.Label = [&](const Frame& f, Labels& l) { LabelsFromResults(f, results, l); };
+        engines.push_back(e);
+    }
+    {
+        Engine e("grid");
+        e.Run = [&](const Frame& f) { results = AgglomerativeClustering(f.pts).cluster(cfg.DThreshold, cfg.CThreshold); };
+        e.Label = [&](const Frame& f, Labels& l) { LabelsFromResults(f, results, l); };
+        engines.push_back(e);
+    }
+    {
+        Engine e("grid (parallel)");
+        e.Run = [&](const Frame& f) { results = AgglomerativeClustering(f.pts).clusterParallel(cfg.DThreshold, cfg.CThreshold, pool); };
+        e.Label = [&](const Frame& f, Labels& l) { LabelsFromResults(f, results, l); };
+        engines.push_back(e);
+    }
+    {
+        Engine e("approximate");
+        e.Run = [&](const Frame& f) { results = AgglomerativeClustering(f.pts).clusterApproximate(cfg.DThreshold, cfg.CThreshold, cfg.MaxPoints); };
+        e.Label = [&](const Frame& f, Labels& l) { LabelsFromResults(f, results, l); };
+        engines.push_back(e);
+    }
+    {
+        Engine e("incremental");
+        e.Run = [&](const Frame& f) { results = incrementalClustering.cluster(f.pts, cfg.DThreshold, cfg.CThreshold); };
+        e.Label = [&](const Frame& f, Labels& l)
+        {
+            LabelsFromResults(f, results, l);
+
+            // seed the next frame with the bounding boxes of this one
+            vector<Box> boxes;
+            for (auto& r : results)
+            {
+                if (r.id >= static_cast<int>(boxes.size())) boxes.resize(r.id + 1, Box(INT_MAX, INT_MAX, INT_MIN, INT_MIN));
+                Box& b = boxes[r.id];
+                b.x1 = min(b.x1, r.pt.x); b.y1 = min(b.y1, r.pt.y);
+                b.x2 = max(b.x2, r.pt.x); b.y2 = max(b.y2, r.pt.y);
+            }
+            incrementalClustering.clearSeeds();
+            for (auto& b : boxes)
+            {
+                if (b.x1 <= b.x2) incrementalClustering.addSeed(b.x1, b.y1, b.x2, b.y2);
+            }
+        };
+        engines.push_back(e);
+    }
+    {
+        Engine e("runs");
+        e.Run = [&](const Frame& f) { runClustering.cluster(&f.mask[0], f.rows, f.cols, f.cols, cfg.DThreshold, cfg.CThreshold); };
+        e.Label = [&](const Frame& f, Labels& l)
+        {
+            l.assign(f.rows * f.cols, -1);
+            for (auto& run : runClustering.getRuns())
+            {
+                for (int y = run.begin; y < run.end; ++y) l[run.row * f.cols + y] = run.id;
+            }
+        };
+        engines.push_back(e);
+    }
+
+    cout << "Clustering " << cfg.FrameCount << " frames of " << cfg.Width << "x" << cfg.Height << ", "
+        << cfg.BlobCount << " blobs of size " << cfg.BlobSize << ", noise density " << cfg.NoiseDensity
+        << ", " << pool.GetWorkerCount() << " threads." << endl;
+
+    FrameGenerator generator(cfg);
+    Frame frame;
+    Labels reference, labels;
+    long long nTotalPoints = 0, nTotalClusters = 0;
+    for (int iFrame = 0; iFrame < cfg.FrameCount; ++iFrame)
+    {
+        generator.Next(frame);
+        nTotalPoints += frame.pts.size();
+        bool isSmall = static_cast<int>(frame.pts.size()) <= cfg.BruteLimit;
+
+        // reference: brute force is the definition, but takes O(n^2); the grid clustering is exact as well
+        LabelsFromResults(frame, isSmall ?
+            AgglomerativeClustering(frame.pts).clusterBruteForce(cfg.DThreshold, cfg.CThreshold) :
+            AgglomerativeClustering(frame.pts).cluster(cfg.DThreshold, cfg.CThreshold), reference);
+        nTotalClusters += CountClusters(reference);
+
+        for (auto& e : engines)
+        {
+            if (e.Name == "brute force" && !isSmall) continue;
+
+            long long heapBase = heapUsed;
+            heapPeak = heapBase;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            e.Run(frame);
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+            e.Seconds += std::chrono::duration<double>(end - start).count();
+            e.PeakBytes = max(e.PeakBytes, heapPeak - heapBase);
+            e.Points += frame.pts.size();
+            ++e.FramesRun;
+
+            e.Label(frame, labels);
+            if (IsSamePartition(reference, labels))
+            {
+                ++e.FramesMatched;
+            }
+            e.Clusters += CountClusters(labels);
+        }
+    }
+
+    cout << "Reference: " << nTotalPoints / cfg.FrameCount << " foreground pixels and "
+        << static_cast<double>(nTotalClusters) / cfg.FrameCount << " clusters per frame." << endl;
+    if (2 * nTotalClusters < static_cast<long long>(cfg.BlobCount) * cfg.FrameCount)
+    {
+        cout << "WARNING: Less than half as many clusters as blobs: blobs are chained by noise (lower --noise) "
+            << "or crowded (fewer --blobs, or a larger frame), so all engines see the same few clusters." << endl;
+    }
+    cout << endl;
+    cout << setw(18) << left << "engine" << right
+        << setw(12) << "ms/frame" << setw(14) << "Mpixels/s" << setw(14) << "peak heap KB"
+        << setw(12) << "clusters" << setw(18) << "matches reference" << endl;
+    for (auto& e : engines)
+    {
+        cout << setw(18) << left << e.Name << right;
+        if (e.FramesRun == 0)
+        {
+            cout << "  skipped (more than " << cfg.BruteLimit << " pixels per frame)" << endl;
+            continue;
+        }
+        cout << fixed << setprecision(3)
+            << setw(12) << e.Seconds * 1000 / e.FramesRun
+            << setw(14) << (e.Seconds > 0 ? e.Points / e.Seconds / 1e6 : 0)
+            << setw(14) << e.PeakBytes / 1024
+            << setprecision(1) << setw(12) << static_cast<double>(e.Clusters) / e.FramesRun
+            << setw(11) << e.FramesMatched << "/" << e.FramesRun << " frames" << endl;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,590 @@
+/// Micro-benchmark and scaling curve of the object matchers, on synthetic objects (no OpenCV, no clips needed).
+///
+/// A world of moving objects is observed once per frame. Observations split objects in two, or merge neighbours into one,
+/// at the given rates, and objects leave and enter the scene at the turnover rate. Every frame's observation is matched
+/// against the last one by all matchers, for every given amount of objects, and compared against the current solver
+/// (the dense Hungarian matching, or the min-cost flow matching, which has the same cost, above --denseLimit objects).
+///
+/// Usage: matchBench [--sizes 10,20,40,80,160] [--frames 50] [--width 1280] [--height 720] [--speed 3] [--minSize 50] [--maxSize 1000]
+///                   [--splitRate 0.05] [--mergeRate 0.05] [--turnover 0.02] [--groups 0] [--groupRadius 100] [--gate 150]
+///                   [--threads 0] [--denseLimit 100] [--budget 33] [--csv file] [--json file] [--seed 1]
+
+#include "matcher.h"
+#include "hungarian.h"
+#include "assignment.h"
+#include "minCostFlow.h"
+#include "groupMatcher.h"
+#include "Workers.h"
+#include "benchHeap.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+using namespace std;
+using namespace Matcher;
+
+
+// ###################################################################################################
+// Synthetic objects
+
+struct BenchConfig
+{
+    vector<int> Sizes;
+    int FrameCount;
+    int Width, Height;
+    double Speed;
+    int MinSize, MaxSize;
+    double SplitRate, MergeRate, Turnover;
+    int GroupCount;
+    double GroupRadius;
+    int Gate;
+    int NThreads;
+    int DenseLimit;
+    double Budget;
+    string CsvFile, JsonFile;
+    unsigned int Seed;
+
+    BenchConfig() :
+        FrameCount(50),
+        Width(1280), Height(720),
+        Speed(3),
+        MinSize(50), MaxSize(1000),
+        SplitRate(0.05), MergeRate(0.05), Turnover(0.02),
+        GroupCount(0),
+        GroupRadius(100),
+        Gate(150),
+        NThreads(0),
+        DenseLimit(100),
+        Budget(33),
+        Seed(1)
+    {
+        int sizes[] = { 10, 20, 40, 80, 160 };
+        Sizes.assign(sizes, sizes + sizeof(sizes) / sizeof(sizes[0]));
+    }
+
+    static bool ParseList(const char* value, vector<int>& list)
+    {
+        list.clear();
+        stringstream ss(value);
+        string item;
+        while (getline(ss, item, ','))
+        {
+            int n = atoi(item.c_str());
+            if (n <= 0) return false;
+            list.push_back(n);
+        }
+        return !list.empty();
+    }
+
+    bool Parse(int argc, char* argv[])
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            string key = argv[i];
+            if (i + 1 >= argc) return false;
+            const char* value = argv[++i];
+            if (key == "--sizes") { if (!ParseList(value, Sizes)) return false; }
+            else if (key == "--frames") FrameCount = atoi(value);
+            else if (key == "--width") Width = atoi(value);
+            else if (key == "--height") Height = atoi(value);
+            else if (key == "--speed") Speed = atof(value);
+            else if (key == "--minSize") MinSize = atoi(value);
+            else if (key == "--maxSize") MaxSize = atoi(value);
+            else if (key == "--splitRate") SplitRate = atof(value);
+            else if (key == "--mergeRate") MergeRate = atof(value);
+            else if (key == "--turnover") Turnover = atof(value);
+            else if (key == "--groups") GroupCount = atoi(value);
+            else if (key == "--groupRadius") GroupRadius = atof(value);
+            else if (key == "--gate") Gate = atoi(value);
+            else if (key == "--threads") NThreads = atoi(value);
+            else if (key == "--denseLimit") DenseLimit = atoi(value);
+            else if (key == "--budget") Budget = atof(value);
+            else if (key == "--csv") CsvFile = value;
+            else if (key == "--json") JsonFile = value;
+            else if (key == "--seed") Seed = static_cast<unsigned int>(atoi(value));
+            else return false;
+        }
+        return Width > 0 && Height > 0 && FrameCount > 0 && MinSize > 0 && MaxSize >= MinSize;
+    }
+};
+
+struct WorldObject
+{
+    double x, y, vx, vy;
+    int size;
+};
+
+/// Moving objects (bouncing off the borders), and what the clustering would make of them in every frame.
+class World
+{
+    const BenchConfig& cfg;
+    std::mt19937 rng;
+    vector<WorldObject> objects;
+    vector<pair<double, double>> groupCenters;
+
+    double Uniform(double lo, double hi)
+    {
+        return std::uniform_real_distribution<double>(lo, hi)(rng);
+    }
+
+    bool Chance(double p)
+    {
+        return p > 0 && Uniform(0, 1) < p;
+    }
+
+    void Spawn(WorldObject& o)
+    {
+        if (groupCenters.empty())
+        {
+            o.x = Uniform(0, cfg.Height);
+            o.y = Uniform(0, cfg.Width);
+        }
+        else
+        {
+            const pair<double, double>& c = groupCenters[std::uniform_int_distribution<int>(0, static_cast<int>(groupCenters.size()) - 1)(rng)];
+            o.x = min<double>(max<double>(c.first + Uniform(-cfg.GroupRadius, cfg.GroupRadius), 0), cfg.Height - 1);
+            o.y = min<double>(max<double>(c.second + Uniform(-cfg.GroupRadius, cfg.GroupRadius), 0), cfg.Width - 1);
+        }
+        o.vx = Uniform(-cfg.Speed, cfg.Speed);
+        o.vy = Uniform(-cfg.Speed, cfg.Speed);
+        o.size = static_cast<int>(Uniform(cfg.MinSize, cfg.MaxSize));
+    }
+
+public:
+    World(const BenchConfig& cfg, int nObjects) : cfg(cfg), rng(cfg.Seed + nObjects)
+    {
+        for (int g = 0; g < cfg.GroupCount; ++g)
+        {
+            groupCenters.push_back(make_pair(Uniform(0, cfg.Height), Uniform(0, cfg.Width)));
+        }
+        objects.resize(nObjects);
+        for (auto& o : objects) Spawn(o);
+    }
+
+    /// Moves all objects one frame ahead, and returns the objects that are observed.
+    void Next(vector<ClusterInfo>& observed)
+    {
+        for (auto& o : objects)
+        {
+            if (Chance(cfg.Turnover))
+            {
+                // one object leaves, another one enters
+                Spawn(o);
+                continue;
+            }
+            o.x += o.vx;
+            o.y += o.vy;
+            if (o.x < 0 || o.x >= cfg.Height) o.vx = -o.vx;
+            if (o.y < 0 || o.y >= cfg.Width) o.vy = -o.vy;
+        }
+
+        observed.clear();
+        vector<char> isMerged(objects.size(), 0);
+        for (size_t i = 0; i < objects.size(); ++i)
+        {
+            if (isMerged[i]) continue;
+            const WorldObject& o = objects[i];
+            int x = static_cast<int>(o.x), y = static_cast<int>(o.y);
+
+            if (Chance(cfg.MergeRate))
+            {
+                // seen together with the nearest object that has not been seen yet
+                int nearest = -1;
+                double nearestDist2 = 0;
+                for (size_t j = i + 1; j < objects.size(); ++j)
+                {
+                    if (isMerged[j]) continue;
+                    double dx = objects[j].x - o.x, dy = objects[j].y - o.y;
+                    if (nearest < 0 || dx * dx + dy * dy < nearestDist2)
+                    {
+                        nearest = static_cast<int>(j);
+                        nearestDist2 = dx * dx + dy * dy;
+                    }
+                }
+                if (nearest >= 0)
+                {
+                    const WorldObject& p = objects[nearest];
+                    isMerged[nearest] = 1;
+                    int size = o.size + p.size;
+                    observed.push_back(ClusterInfo(static_cast<int>((o.x * o.size + p.x * p.size) / size),
+                        static_cast<int>((o.y * o.size + p.y * p.size) / size), size));
+                    continue;
+                }
+            }
+            if (Chance(cfg.SplitRate))
+            {
+                // seen as two halves, side by side
+                int offset = static_cast<int>(sqrt(static_cast<double>(o.size)) / 2) + 1;
+                observed.push_back(ClusterInfo(x, y - offset, o.size / 2));
+                observed.push_back(ClusterInfo(x, y + offset, o.size - o.size / 2));
+                continue;
+            }
+            observed.push_back(ClusterInfo(x, y, o.size));
+        }
+    }
+};
+
+
+// ###################################################################################################
+// Matchers
+
+struct Solvers
+{
+    Hungarian::HungarianMethod hungarian;
+    Assignment::SparseAssignment sparse;
+    Flow::MinCostFlow flow;
+    MatchDuals duals;
+    GroupMatcher groups;
+};
+
+/// One matcher. Run() is timed, and returns the matching cost; it may decline frames that are too large for it.
+struct Engine
+{
+    string Name;
+    std::function<bool(const vector<ClusterInfo>&, const vector<ClusterInfo>&, long long&)> Run;
+    std::unique_ptr<Solvers> State;
+    vector<pair<int, int>> Links;
+
+    // totals of the current amount of objects
+    double Seconds, MaxSeconds;
+    long long PeakBytes, RetainedBytes;
+    double Agreement;
+    int FramesRun, FramesSkipped, CostsMatched;
+
+    Engine(const string& name) : Name(name) { Reset(); }
+
+    void Reset()
+    {
+        State = std::unique_ptr<Solvers>(new Solvers());
+        Links.clear();
+        Seconds = MaxSeconds = 0;
+        PeakBytes = RetainedBytes = 0;
+        Agreement = 0;
+        FramesRun = FramesSkipped = CostsMatched = 0;
+    }
+};
+
+/// Share of links that both matchings have in common.
+double LinkAgreement(vector<pair<int, int>> a, vector<pair<int, int>> b)
+{
+    if (a.empty() && b.empty()) return 1;
+    sort(a.begin(), a.end());
+    sort(b.begin(), b.end());
+    size_t common = 0;
+    for (size_t i = 0, j = 0; i < a.size() && j < b.size(); )
+    {
+        if (a[i] < b[j]) ++i;
+        else if (b[j] < a[i]) ++j;
+        else { ++common; ++i; ++j; }
+    }
+    return static_cast<double>(common) / max(a.size(), b.size());
+}
+
+/// Regression check of the warm-started Hungarian solver: whatever the given labels are, 
+/// it must find the same cost as a cold start, on square as well as on wide (xn<yn) problems.
+bool CheckWarmStart(unsigned int seed)
+{
+    Hungarian::HungarianMethod cold, warm;
+
+    // 1 x 2: the labels make the cheaper y tight first, and the other one must not stay matched out
+    warm.resize(1, 2);
+    warm.setCost(0, 0, 5);
+    warm.setCost(0, 1, 10);
+    warm.setYLabel(0, 0);
+    warm.setYLabel(1, 5);
+    if (warm.maximumMatching(true) != 10)
+    {
+        cerr << "Warm-started 1x2 matching is not optimal." << endl;
+        return false;
+    }
+
+    mt19937 rng(seed);
+    uniform_int_distribution<int> costDist(0, 100), labelDist(-50, 50);
+    for (int iProblem = 0; iProblem < 1000; ++iProblem)
+    {
+        int xn = 1 + iProblem % 8;
+        int yn = xn + iProblem / 8 % 4;
+        cold.resize(xn, yn);
+        warm.resize(xn, yn);
+        for (int x = 0; x < xn; ++x)
+        {
+            for (int y = 0; y < yn; ++y)
+            {
+                int c = costDist(rng);
+                cold.setCost(x, y, c);
+                warm.setCost(x, y, c);
+            }
+        }
+        for (int y = 0; y < yn; ++y) warm.setYLabel(y, labelDist(rng));
+
+        long long coldCost = cold.maximumMatching();
+        long long warmCost = warm.maximumMatching(true);
+        if (warmCost != coldCost)
+        {
+            cerr << "Warm-started " << xn << "x" << yn << " matching costs " << warmCost << " instead of " << coldCost << "." << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Regression check of the warm-started group matching, which carries labels from frame to frame while the groups change:
+/// it must find the same cost as a cold start.
+bool CheckGroupWarmStart(const BenchConfig& cfg)
+{
+    GroupMatcher warm, cold;
+    World world(cfg, 40);
+    vector<ClusterInfo> prev, cur;
+    vector<pair<int, int>> warmLinks, coldLinks;
+    world.Next(prev);
+    for (int iFrame = 0; iFrame < 20; ++iFrame)
+    {
+        world.Next(cur);
+        ClusterMatcher cm(prev, cur);
+        cold.clear();
+        long long coldCost = cold.solve(cm, coldLinks, cfg.Gate, MatchMethod::Dense);
+        long long warmCost = warm.solve(cm, warmLinks, cfg.Gate, MatchMethod::Dense);
+        if (warmCost != coldCost)
+        {
+            cerr << "Warm-started group matching of frame " << iFrame << " costs " << warmCost << " instead of " << coldCost << "." << endl;
+            return false;
+        }
+        swap(prev, cur);
+    }
+    return true;
+}
+
+/// One point of the scaling curve.
+struct CurvePoint
+{
+    int Objects;
+    double ObjectsPerFrame;
+    string Engine;
+    int Frames, Skipped;
+    double MeanMs, MaxMs;
+    long long PeakKB;
+    double CostMatches, LinkAgreement;
+};
+
+
+// ###################################################################################################
+// main
+
+int main(int argc, char* argv[])
+{
+    BenchConfig cfg;
+    if (!cfg.Parse(argc, argv))
+    {
+        cerr << "Usage: matchBench [--sizes n,n,...] [--frames n] [--width n] [--height n] [--speed px] [--minSize n] [--maxSize n]" << endl;
+        cerr << "                  [--splitRate p] [--mergeRate p] [--turnover p] [--groups n] [--groupRadius px] [--gate px]" << endl;
+        cerr << "                  [--threads n] [--denseLimit n] [--budget ms] [--csv file] [--json file] [--seed n]" << endl;
+        return EXIT_FAILURE;
+    }
+
+    if (!CheckWarmStart(cfg.Seed) || !CheckGroupWarmStart(cfg))
+    {
+        return EXIT_FAILURE;
+    }
+
+    Util::WorkerPool pool(cfg.NThreads);
+
+    vector<std::unique_ptr<Engine>> engines;
+    {
+        Engine* e = new Engine("dense");
+        engines.push_back(std::unique_ptr<Engine>(e));
+        e->Run = [&cfg, e](const vector<ClusterInfo>& prev, const vector<ClusterInfo>& cur, long long& cost) {
+            if (static_cast<int>(prev.size()) > cfg.DenseLimit) return false;
+            cost = ClusterMatcher(prev, cur).solve(e->Links, e->State->hungarian);
+            return true;
+        };
+    }
+    {
+        Engine* e = new Engine("dense (warm)");
+        engines.push_back(std::unique_ptr<Engine>(e));
+        e->Run = [&cfg, e](const vector<ClusterInfo>& prev, const vector<ClusterInfo>& cur, long long& cost) {
+            if (static_cast<int>(prev.size()) > cfg.DenseLimit) return false;
+            cost = ClusterMatcher(prev, cur).solve(e->Links, e->State->hungarian, e->State->duals);
+            return true;
+        };
+    }
+    {
+        Engine* e = new Engine("sparse");
+        engines.push_back(std::unique_ptr<Engine>(e));
+        e->Run = [&cfg, e](const vector<ClusterInfo>& prev, const vector<ClusterInfo>& cur, long long& cost) {
+            cost = ClusterMatcher(prev, cur).solveSparse(e->Links, cfg.Gate, e->State->sparse);
+            return true;
+        };
+    }
+    {
+        Engine* e = new Engine("flow");
+        engines.push_back(std::unique_ptr<Engine>(e));
+        e->Run = [e](const vector<ClusterInfo>& prev, const vector<ClusterInfo>& cur, long long& cost) {
+            cost = ClusterMatcher(prev, cur).solveFlow(e->Links, e->State->flow);
+            return true;
+        };
+    }
+    {
+        Engine* e = new Engine("groups");
+        engines.push_back(std::unique_ptr<Engine>(e));
+        e->Run = [&cfg, e](const vector<ClusterInfo>& prev, const vector<ClusterInfo>& cur, long long& cost) {
+            ClusterMatcher cm(prev, cur);
+            cost = e->State->groups.solve(cm, e->Links, cfg.Gate, MatchMethod::Dense);
+            return true;
+        };
+    }
+    {
+        Engine* e = new Engine("groups (parallel)");
+        engines.push_back(std::unique_ptr<Engine>(e));
+        e->Run = [&cfg, &pool, e](const vector<ClusterInfo>& prev, const vector<ClusterInfo>& cur, long long& cost) {
+            ClusterMatcher cm(prev, cur);
+            e->State->groups.setPool(&pool);
+            cost = e->State->groups.solve(cm, e->Links, cfg.Gate, MatchMethod::Dense);
+            return true;
+        };
+    }
+
+    cout << "Matching " << cfg.FrameCount << " frames per size in " << cfg.Width << "x" << cfg.Height
+        << ", speed " << cfg.Speed << ", split rate " << cfg.SplitRate << ", merge rate " << cfg.MergeRate
+        << ", turnover " << cfg.Turnover << ", " << (cfg.GroupCount > 0 ? cfg.GroupCount : 1) << (cfg.GroupCount > 0 ? " groups" : " uniform scene")
+        << ", gate " << cfg.Gate << ", " << pool.GetWorkerCount() << " threads." << endl;
+
+    vector<CurvePoint> curve;
+    Solvers reference;
+    vector<pair<int, int>> referenceLinks;
+    vector<ClusterInfo> prev, cur;
+    for (size_t iSize = 0; iSize < cfg.Sizes.size(); ++iSize)
+    {
+        int nObjects = cfg.Sizes[iSize];
+        for (auto& e : engines) e->Reset();
+
+        World world(cfg, nObjects);
+        world.Next(prev);
+        long long nTotalObjects = 0;
+        for (int iFrame = 0; iFrame < cfg.FrameCount; ++iFrame)
+        {
+            world.Next(cur);
+            nTotalObjects += cur.size();
+
+            // the current solver; min-cost flow has the same cost, and is used where dense matching would take too long
+            bool isDense = static_cast<int>(prev.size()) <= cfg.DenseLimit;
+            long long referenceCost = isDense ?
+                ClusterMatcher(prev, cur).solve(referenceLinks, reference.hungarian) :
+                ClusterMatcher(prev, cur).solveFlow(referenceLinks, reference.flow);
+
+            for (auto& e : engines)
+            {
+                long long heapBase = heapUsed;
+                heapPeak = heapBase;
+                long long cost;
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                bool isRun = e->Run(prev, cur, cost);
+                std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+                if (!isRun)
+                {
+                    ++e->FramesSkipped;
+                    continue;
+                }
+
+                // buffers that the engine keeps count as well
+                double seconds = std::chrono::duration<double>(end - start).count();
+                e->Seconds += seconds;
+                e->MaxSeconds = max(e->MaxSeconds, seconds);
+                e->PeakBytes = max(e->PeakBytes, e->RetainedBytes + heapPeak - heapBase);
+                e->RetainedBytes += heapUsed - heapBase;
+                ++e->FramesRun;
+
+                if (cost == referenceCost) ++e->CostsMatched;
+                e->Agreement += LinkAgreement(e->Links, referenceLinks);
+            }
+            swap(prev, cur);
+        }
+
+        double objectsPerFrame = static_cast<double>(nTotalObjects) / cfg.FrameCount;
+        cout << endl << nObjects << " objects (" << fixed << setprecision(1) << objectsPerFrame << " observed per frame):" << endl;
+        cout << setw(20) << left << "matcher" << right
+            << setw(12) << "ms/match" << setw(12) << "max ms" << setw(14) << "peak heap KB"
+            << setw(16) << "same cost" << setw(16) << "same links" << endl;
+        for (auto& e : engines)
+        {
+            cout << setw(20) << left << e->Name << right;
+            if (e->FramesRun == 0)
+            {
+                cout << "  skipped (more than " << cfg.DenseLimit << " objects)" << endl;
+                continue;
+            }
+            CurvePoint p;
+            p.Objects = nObjects;
+            p.ObjectsPerFrame = objectsPerFrame;
+            p.Engine = e->Name;
+            p.Frames = e->FramesRun;
+            p.Skipped = e->FramesSkipped;
+            p.MeanMs = e->Seconds * 1000 / e->FramesRun;
+            p.MaxMs = e->MaxSeconds * 1000;
+            p.PeakKB = e->PeakBytes / 1024;
+            p.CostMatches = static_cast<double>(e->CostsMatched) / e->FramesRun;
+            p.LinkAgreement = e->Agreement / e->FramesRun;
+            curve.push_back(p);
+
+            cout << setprecision(3)
+                << setw(12) << p.MeanMs << setw(12) << p.MaxMs << setw(14) << p.PeakKB
+                << setw(9) << e->CostsMatched << "/" << e->FramesRun << " frames"
+                << setprecision(1) << setw(15) << p.LinkAgreement * 100 << "%" << endl;
+        }
+    }
+
+    if (cfg.Budget > 0)
+    {
+        // largest size whose slowest matching still fits the budget
+        cout << endl << "Largest amount of objects matched within " << cfg.Budget << " ms (worst case):" << endl;
+        for (auto& e : engines)
+        {
+            int best = 0;
+            for (auto& p : curve)
+            {
+                if (p.Engine == e->Name && p.Skipped == 0 && p.MaxMs <= cfg.Budget) best = max(best, p.Objects);
+            }
+            cout << setw(20) << left << e->Name << right << setw(12);
+            if (best > 0) cout << best << endl;
+            else cout << "none" << endl;
+        }
+    }
+
+    if (!cfg.CsvFile.empty())
+    {
+        ofstream csv(cfg.CsvFile.c_str());
+        csv << "objects,objectsPerFrame,matcher,frames,skipped,meanMs,maxMs,peakKB,sameCost,sameLinks" << endl;
+        for (auto& p : curve)
+        {
+            csv << p.Objects << "," << p.ObjectsPerFrame << "," << p.Engine << "," << p.Frames << "," << p.Skipped << ","
+                << p.MeanMs << "," << p.MaxMs << "," << p.PeakKB << "," << p.CostMatches << "," << p.LinkAgreement << endl;
+        }
+        if (!csv) cerr << "WARNING: Unable to write " << cfg.CsvFile << endl;
+    }
+    if (!cfg.JsonFile.empty())
+    {
+        ofstream json(cfg.JsonFile.c_str());
+        json << "[" << endl;
+        for (size_t i = 0; i < curve.size(); ++i)
+        {
+            const CurvePoint& p = curve[i];
+            json << "  { \"objects\" : " << p.Objects << ", \"objectsPerFrame\" : " << p.ObjectsPerFrame
+                << ", \"matcher\" : \"" << p.Engine << "\", \"frames\" : " << p.Frames << ", \"skipped\" : " << p.Skipped
+                << ", \"meanMs\" : " << p.MeanMs << ", \"maxMs\" : " << p.MaxMs << ", \"peakKB\" : " << p.PeakKB
+                << ", \"sameCost\" : " << p.CostMatches << ", \"sameLinks\" : " << p.LinkAgreement << " }"
+                << (i + 1 < curve.size() ? "," : "") << endl;
+        }
+        json << "]" << endl;
+        if (!json) cerr << "WARNING: Unable to write " << cfg.JsonFile << endl;
+    }
+
+    return EXIT_SUCCESS;
+}
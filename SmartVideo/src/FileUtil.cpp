@@ -0,0 +1,243 @@
+#include "FileUtil.h"
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#include <cstdio>
+
+using namespace std;
+
+namespace Util
+{
+    bool RenameFile(const std::string& oldName, const std::string& newName)
+    {
+#ifdef _WIN32
+        // rename() does not replace existing files on Windows
+        return MoveFileExA(oldName.c_str(), newName.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        return rename(oldName.c_str(), newName.c_str()) == 0;
+#endif
+    }
+
+    bool WriteFileAtomic(const std::string& fname, const unsigned char* data, size_t size)
+    {
+        string tmpName = fname + ".tmp";
+        {
+            ofstream file(tmpName, ofstream::out | ofstream::binary | ofstream::trunc);
+            if (!file) return false;
+
+            if (size > 0 && !file.write(reinterpret_cast<const char*>(data), size))
+            {
+                file.close();
+                remove(tmpName.c_str());
+                return false;
+            }
+        }
+
+        if (!RenameFile(tmpName, fname))
+        {
+            remove(tmpName.c_str());
+            return false;
+        }
+        return true;
+    }
+
+#ifdef _WIN32
+
+    MappedFile::MappedFile() :
+        data(nullptr),
+        size(0),
+        isWritable(false),
+        fileHandle(INVALID_HANDLE_VALUE),
+        mappingHandle(nullptr)
+    {
+    }
+
+    bool MappedFile::OpenRead(const std::string& fname)
+    {
+        Close();
+
+        fileHandle = CreateFileA(fname.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (fileHandle == INVALID_HANDLE_VALUE) return false;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+        {
+            Close();
+            return false;
+        }
+
+        mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mappingHandle)
+        {
+            Close();
+            return false;
+        }
+
+        data = static_cast<unsigned char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+        if (!data)
+        {
+            Close();
+            return false;
+        }
+
+        size = static_cast<size_t>(fileSize.QuadPart);
+        isWritable = false;
+        return true;
+    }
+
+    bool MappedFile::Create(const std::string& fname, size_t newSize)
+    {
+        Close();
+
+        fileHandle = CreateFileA(fname.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (fileHandle == INVALID_HANDLE_VALUE) return false;
+
+        // mapping a file with a size larger than the file grows the file
+        unsigned long long size64 = newSize;
+        mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READWRITE, static_cast<DWORD>(size64 >> 32), static_cast<DWORD>(size64), nullptr);
+        if (!mappingHandle)
+        {
+            Close();
+            return false;
+        }
+
+        data = static_cast<unsigned char*>(MapViewOfFile(mappingHandle, FILE_MAP_WRITE, 0, 0, 0));
+        if (!data)
+        {
+            Close();
+            return false;
+        }
+
+        size = newSize;
+        isWritable = true;
+        return true;
+    }
+
+    void MappedFile::Flush()
+    {
+        if (data && isWritable)
+        {
+            FlushViewOfFile(data, 0);
+            FlushFileBuffers(fileHandle);
+        }
+    }
+
+    void MappedFile::Close()
+    {
+        if (data)
+        {
+            UnmapViewOfFile(data);
+            data = nullptr;
+        }
+        if (mappingHandle)
+        {
+            CloseHandle(mappingHandle);
+            mappingHandle = nullptr;
+        }
+        if (fileHandle != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(fileHandle);
+            fileHandle = INVALID_HANDLE_VALUE;
+        }
+        size = 0;
+        isWritable = false;
+    }
+
+#else
+
+    MappedFile::MappedFile() :
+        data(nullptr),
+        size(0),
+        isWritable(false),
+        fd(-1)
+    {
+    }
+
+    bool MappedFile::OpenRead(const std::string& fname)
+    {
+        Close();
+
+        fd = open(fname.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            Close();
+            return false;
+        }
+
+        void* ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (ptr == MAP_FAILED)
+        {
+            Close();
+            return false;
+        }
+        madvise(ptr, st.st_size, MADV_SEQUENTIAL);
+
+        data = static_cast<unsigned char*>(ptr);
+        size = st.st_size;
+        isWritable = false;
+        return true;
+    }
+
+    bool MappedFile::Create(const std::string& fname, size_t newSize)
+    {
+        Close();
+
+        fd = open(fname.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return false;
+
+        if (ftruncate(fd, newSize) != 0)
+        {
+            Close();
+            return false;
+        }
+
+        void* ptr = mmap(nullptr, newSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (ptr == MAP_FAILED)
+        {
+            Close();
+            return false;
+        }
+
+        data = static_cast<unsigned char*>(ptr);
+        size = newSize;
+        isWritable = true;
+        return true;
+    }
+
+    void MappedFile::Flush()
+    {
+        if (data && isWritable)
+        {
+            msync(data, size, MS_SYNC);
+        }
+    }
+
+    void MappedFile::Close()
+    {
+        if (data)
+        {
+            munmap(data, size);
+            data = nullptr;
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+        size = 0;
+        isWritable = false;
+    }
+
+#endif
+}
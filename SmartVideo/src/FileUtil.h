@@ -19,6 +19,62 @@ namespace Util
     {
         mkdir(fname.c_str(), mode);
     }
+
+    /// Renames the given file, replacing any existing file of the new name.
+    bool RenameFile(const std::string& oldName, const std::string& newName);
+
+    /// Writes size bytes into a temporary file next to fname, and then renames it to fname,
+    /// so readers never see a partially written file.
+    bool WriteFileAtomic(const std::string& fname, const unsigned char* data, size_t size);
+
+
+    /// A file that is mapped into memory.
+    /// Note: Platform-specific code lives in FileUtil.cpp, so this header does not pull in any OS headers.
+    class MappedFile
+    {
+        unsigned char* data;
+        size_t size;
+        bool isWritable;
+
+#ifdef _WIN32
+        void* fileHandle;
+        void* mappingHandle;
+#else
+        int fd;
+#endif
+
+        /// Disallow copy ctor
+        MappedFile(const MappedFile&);
+        MappedFile& operator=(const MappedFile&);
+
+    public:
+        MappedFile();
+
+        virtual ~MappedFile()
+        {
+            Close();
+        }
+
+        /// Maps the whole existing file read-only. Returns false, if the file could not be mapped.
+        bool OpenRead(const std::string& fname);
+
+        /// Creates (or truncates) the given file to the given size and maps it writable.
+        /// Returns false, if the file could not be created or mapped.
+        bool Create(const std::string& fname, size_t size);
+
+        /// Writes all changes back to disk (if writable) and unmaps the file.
+        void Close();
+
+        /// Writes all changes back to disk.
+        void Flush();
+
+        bool IsOpen() const { return data != nullptr; }
+        bool IsWritable() const { return isWritable; }
+
+        unsigned char* GetData() { return data; }
+        const unsigned char* GetData() const { return data; }
+        size_t GetSize() const { return size; }
+    };
 }
 
-#endif // UTIL_FILEUTIL_H
\ No newline at end of file
+#endif // UTIL_FILEUTIL_H
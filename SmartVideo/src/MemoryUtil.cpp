@@ -0,0 +1,96 @@
+#include "MemoryUtil.h"
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+#endif
+
+namespace Util
+{
+#ifdef _WIN32
+
+    /// Large pages require the "Lock pages in memory" privilege, which has to be enabled once per process.
+    static bool EnableLockMemoryPrivilege()
+    {
+        HANDLE token;
+        if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) return false;
+
+        TOKEN_PRIVILEGES privileges;
+        privileges.PrivilegeCount = 1;
+        privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+        bool ok = LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid) &&
+                  AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) &&
+                  GetLastError() == ERROR_SUCCESS;
+        CloseHandle(token);
+        return ok;
+    }
+
+    void* AllocPages(size_t& size, bool tryLargePages, bool* usesLargePages)
+    {
+        if (usesLargePages) *usesLargePages = false;
+
+        if (tryLargePages)
+        {
+            static const bool canUseLargePages = EnableLockMemoryPrivilege();
+            size_t largePageSize = GetLargePageMinimum();
+            if (canUseLargePages && largePageSize > 0)
+            {
+                size_t largeSize = (size + largePageSize - 1) / largePageSize * largePageSize;
+                void* ptr = VirtualAlloc(nullptr, largeSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+                if (ptr)
+                {
+                    size = largeSize;
+                    if (usesLargePages) *usesLargePages = true;
+                    return ptr;
+                }
+            }
+        }
+        return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+
+    void FreePages(void* ptr, size_t size)
+    {
+        if (ptr) VirtualFree(ptr, 0, MEM_RELEASE);
+    }
+
+#else
+
+    static const size_t HugePageSize = 2 * 1024 * 1024;
+
+    void* AllocPages(size_t& size, bool tryLargePages, bool* usesLargePages)
+    {
+        if (usesLargePages) *usesLargePages = false;
+
+        if (tryLargePages)
+        {
+            size = (size + HugePageSize - 1) / HugePageSize * HugePageSize;
+#ifdef MAP_HUGETLB
+            void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (ptr != MAP_FAILED)
+            {
+                if (usesLargePages) *usesLargePages = true;
+                return ptr;
+            }
+#endif
+        }
+
+        void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) return nullptr;
+
+#ifdef MADV_HUGEPAGE
+        // fall back to transparent huge pages
+        if (tryLargePages) madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+        return ptr;
+    }
+
+    void FreePages(void* ptr, size_t size)
+    {
+        if (ptr) munmap(ptr, size);
+    }
+
+#endif
+}
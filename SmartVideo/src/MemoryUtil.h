@@ -0,0 +1,18 @@
+#ifndef UTIL_MEMORYUTIL_H
+#define UTIL_MEMORYUTIL_H
+
+#include <cstddef>
+
+namespace Util
+{
+    /// Allocates page-aligned memory directly from the OS.
+    /// If tryLargePages is set, large (huge) pages are used where the OS allows it, and normal pages otherwise.
+    /// size is rounded up to what has actually been allocated, and must be passed to FreePages unchanged.
+    /// Returns nullptr, if no memory could be allocated.
+    void* AllocPages(size_t& size, bool tryLargePages, bool* usesLargePages = nullptr);
+
+    /// Releases memory allocated by AllocPages.
+    void FreePages(void* ptr, size_t size);
+}
+
+#endif // UTIL_MEMORYUTIL_H
@@ -30,11 +30,61 @@ namespace SmartVideo
         MaskDir = JSonGetProperty(cfgRoot, "maskDir")->GetStringValue();
         DisplayFrames = JSonGetProperty(cfgRoot, "displayResults")->int_value != 0;
         LearningRate = JSonGetProperty(cfgRoot, "learningRate")->float_value;
+        BackgroundEngine = JSonGetProperty(cfgRoot, "backgroundEngine")->GetStringValue();
+        BackgroundThreshold = JSonGetProperty(cfgRoot, "backgroundThreshold")->float_value;
+        AnalysisScale = JSonGetProperty(cfgRoot, "analysisScale")->int_value;
+        if (AnalysisScale <= 0)
+        {
+            AnalysisScale = 1;
+        }
         CachedImageType = JSonGetProperty(cfgRoot, "cachedImageType")->GetStringValue();
         UseCachedForForeground = JSonGetProperty(cfgRoot, "useCachedForForeground")->int_value > 0;
         MaxSpeedUp = JSonGetProperty(cfgRoot, "maxSpeedUp")->float_value;
         TotalPlaybackTime = JSonGetProperty(cfgRoot, "totalPlaybackTime")->float_value;
         Fps = JSonGetProperty(cfgRoot, "fps")->float_value;
+        VideoSegmentLength = JSonGetProperty(cfgRoot, "videoSegmentLength")->int_value;
+        UseLargePages = JSonGetProperty(cfgRoot, "useLargePages")->int_value != 0;
+        UseFrameCache = JSonGetProperty(cfgRoot, "useFrameCache")->int_value != 0;
+        FrameCacheDir = JSonGetProperty(cfgRoot, "frameCacheDir")->GetStringValue();
+        ClusteringEngine = JSonGetProperty(cfgRoot, "clusteringEngine")->GetStringValue();
+        ClusterRefreshInterval = JSonGetProperty(cfgRoot, "clusterRefreshInterval")->int_value;
+        MaxUnseededRatio = JSonGetProperty(cfgRoot, "maxUnseededRatio")->float_value;
+        ClusteringThreads = JSonGetProperty(cfgRoot, "clusteringThreads")->int_value;
+        MaxClusterPoints = JSonGetProperty(cfgRoot, "maxClusterPoints")->int_value;
+        MatcherMode = JSonGetProperty(cfgRoot, "matcherMode")->GetStringValue();
+        MatchGate = JSonGetProperty(cfgRoot, "matchGate")->int_value;
+        if (MatchGate <= 0)
+        {
+            MatchGate = 150;
+        }
+        MatchingThreads = JSonGetProperty(cfgRoot, "matchingThreads")->int_value;
+        MotionModel = JSonGetProperty(cfgRoot, "motionModel")->GetStringValue();
+        KalmanProcessNoise = JSonGetProperty(cfgRoot, "kalmanProcessNoise")->float_value;
+        KalmanMeasurementNoise = JSonGetProperty(cfgRoot, "kalmanMeasurementNoise")->float_value;
+        KalmanGate = JSonGetProperty(cfgRoot, "kalmanGate")->float_value;
+        if (KalmanGate <= 0)
+        {
+            KalmanGate = 3.0;
+        }
+        WriteTracks = JSonGetProperty(cfgRoot, "writeTracks")->int_value != 0;
+        PipelineStages = JSonGetProperty(cfgRoot, "pipelineStages")->int_value != 0;
+        StageQueueSize = JSonGetProperty(cfgRoot, "stageQueueSize")->int_value;
+        if (StageQueueSize <= 0)
+        {
+            StageQueueSize = 4;
+        }
+        WriterBatchSize = JSonGetProperty(cfgRoot, "writerBatchSize")->int_value;
+        if (WriterBatchSize <= 0)
+        {
+            WriterBatchSize = 8;
+        }
+        WriterQueueSize = JSonGetProperty(cfgRoot, "writerQueueSize")->int_value;
+        if (WriterQueueSize <= 0)
+        {
+            WriterQueueSize = 2 * WriterBatchSize;
+        }
+        ParallelClips = max(JSonGetProperty(cfgRoot, "parallelClips")->int_value, 1);
+        ThreadBudget = JSonGetProperty(cfgRoot, "threadBudget")->int_value;
 
         std::string clipListPath(GetClipListPath());
         json_value * clipRoot = JSonReadFile(clipListPath);
@@ -88,18 +138,38 @@ namespace SmartVideo
         this->clipEntry = clipEntry;
 
         // wait for previous I/O operations to stop
+        frameInBuffer.Close();
         ioPool.Stop();
         ioPool.Join();
+        frameWriter.Finish();
 
-        pMOG = unique_ptr<BackgroundSubtractorMOG>(new BackgroundSubtractorMOG()); //MOG approach
-        frameInBuffer.Clear();
-        frameOutBuffer.Clear();
+        backgroundModel = CreateBackgroundModel(Config.BackgroundEngine, Config.BackgroundThreshold);
+        ReleaseQueuedFrames();
+
+        isPipelined = Config.PipelineStages;
+        if (isPipelined && Config.DisplayFrames)
+        {
+            // HighGUI windows must only be used by the thread that created them
+            cerr << "WARNING: pipelineStages is ignored while displayResults is enabled." << endl;
+            isPipelined = false;
+        }
 
         // initialize object tracking variables
         InitObjectTracking();
 
         // allocate frame weights
-        frameWeights.resize(clipEntry->GetFrameCount());
+        nFrameCount = clipEntry->GetFrameCount();
+        frameWeights.resize(nFrameCount);
+
+        // stream tracks next to the weights (needs the frame count)
+        if (Config.WriteTracks && clipEntry->WeightFile.size() > 0)
+        {
+            if (!trackStore.Create(Config.GetTrackFilePath(*clipEntry), clipEntry->StartFrame, GetProcessFrameCount()))
+            {
+                cerr << "WARNING: Unable to create track file " << Config.GetTrackFilePath(*clipEntry) << endl;
+            }
+        }
+
         if (Config.DisplayFrames)
         {
             // create GUI windows (for debugging purposes)
@@ -108,14 +178,121 @@ namespace SmartVideo
             namedWindow("Foreground");
         }
 
-        auto nTotalFrames = clipEntry->GetFrameCount() - 1;
+        auto nTotalFrames = nFrameCount - 1;
+
+        // setup input buffer and readers
+        int nReadThreads = Config.NReadThreads;
+        int inBufferSize = Config.MaxIOQueueSize;
+        Job readJob = std::bind(&SmartVideoProcessor::ReadNextInputFrame, this, std::placeholders::_1);
+        if (clipEntry->Type == ClipType::Video)
+        {
+            if (Config.VideoSegmentLength > 0)
+            {
+                // every reader decodes whole segments with its own capture;
+                // the buffer must hold all segments in flight, or readers of later segments would just wait
+                readJob = std::bind(&SmartVideoProcessor::ReadNextVideoSegment, this, std::placeholders::_1);
+                inBufferSize = max(inBufferSize, nReadThreads * Config.VideoSegmentLength);
+            }
+            else
+            {
+                // VideoCapture is not thread-safe
+                nReadThreads = 1;
+            }
+        }
+        frameInBuffer.Reset(clipEntry->StartFrame, inBufferSize);
+
+        if (Config.UseFrameCache && clipEntry->Type == ClipType::ImageSequence)
+        {
+            InitFrameCache();
+        }
+        InitFramePool();
 
         // start I/O queue
-        ioPool.AddWorkers(Config.NReadThreads, std::bind(&SmartVideoProcessor::ReadNextInputFrame, this, std::placeholders::_1));
+        ioPool.RunJob(nReadThreads, readJob);
+
+        StartFrameWriter();
 
         cout << "Processing " << clipEntry->Name << "..." << endl;
 
-        progressBar.InitProgressBar(nTotalFrames);
+        if (Config.ShowProgress)
+        {
+            progressBar.InitProgressBar(nTotalFrames);
+        }
+    }
+
+
+    void SmartVideoProcessor::InitFrameCache()
+    {
+        auto fname = Config.GetFrameCachePath(*clipEntry);
+        if (frameCache.Open(fname, clipEntry->StartFrame, nFrameCount - clipEntry->StartFrame))
+        {
+            return;
+        }
+
+        // the cache does not exist yet
+        int width, height;
+        if (!ProbeFrameSize(width, height))
+        {
+            // error will be reported by the reader
+            return;
+        }
+
+        MkDir(Config.GetFrameCacheFolder());        // make sure that folder exists
+        if (!frameCache.Create(fname, clipEntry->StartFrame, nFrameCount - clipEntry->StartFrame, width, height, CV_8UC3))
+        {
+            cerr << "WARNING: Unable to create frame cache " << fname << endl;
+        }
+    }
+
+
+    void SmartVideoProcessor::InitFramePool()
+    {
+        int width, height;
+        if (!ProbeFrameSize(width, height))
+        {
+            // error will be reported by the reader
+            framePool.Clear();
+            return;
+        }
+
+        // every frame in the input buffer, plus the one that is being processed, 
+        // plus the ones waiting for the writer, plus the batch that the writer is dumping
+        int nBuffers = frameInBuffer.GetCapacity() + 1 + Config.WriterQueueSize + Config.WriterBatchSize;
+        if (isPipelined)
+        {
+            // plus every frame in a stage queue, or in one of the stages
+            nBuffers += NPipelineStages * (Config.StageQueueSize + 1);
+        }
+        framePool.Init(nBuffers, width, height, Config.AnalysisScale, Config.UseLargePages);
+    }
+
+
+    bool SmartVideoProcessor::ProbeFrameSize(int& width, int& height)
+    {
+        if (nFrameCount <= static_cast<JobIndex>(clipEntry->StartFrame))
+        {
+            return false;
+        }
+
+        if (clipEntry->Type == ClipType::Video)
+        {
+            width = static_cast<int>(clipEntry->Video.get(CV_CAP_PROP_FRAME_WIDTH));
+            height = static_cast<int>(clipEntry->Video.get(CV_CAP_PROP_FRAME_HEIGHT));
+        }
+        else if (frameCache.IsReadable())
+        {
+            Mat frame = frameCache.GetFrame(clipEntry->StartFrame);
+            width = frame.cols;
+            height = frame.rows;
+        }
+        else
+        {
+            string fpath = Config.GetClipFolder(*clipEntry) + "/" + clipEntry->Filenames[clipEntry->StartFrame];
+            Mat frame = imread(fpath);
+            width = frame.cols;
+            height = frame.rows;
+        }
+        return width > 0 && height > 0;
     }
 
 
@@ -135,23 +312,36 @@ namespace SmartVideo
     /// Finalize processing.
     void SmartVideoProcessor::FinishProcessing()
     {
-        cout << endl;
+        if (Config.ShowProgress)
+        {
+            // end progress bar line
+            cout << endl;
+        }
         if (clipEntry->Video.isOpened())
         {
             // delete capture object
             clipEntry->Video.release();
         }
 
+        // wait for all masks to be written
+        frameWriter.Finish();
+
+        // finish (or release) frame cache
+        frameCache.Close();
+
+        // move track file into place
+        trackStore.Close();
+
         if (clipEntry->WeightFile.size() > 0)
         {
             // write weight file
             WriteLines(Config.GetWeightsPath(*clipEntry), frameWeights);
             WriteLines(Config.GetPlaybackPath(*clipEntry), playbackSequence);
-            cout << "Done.";
+            cout << "Done with " << clipEntry->Name << ".";
         }
         else
         {
-            cout << "WARNING: No Weight file given. Results have not been stored.";
+            cout << "WARNING: No Weight file given. Results of " << clipEntry->Name << " have not been stored.";
         }
         cout << endl << endl;
 
@@ -159,16 +349,29 @@ namespace SmartVideo
     }
 
     /// Process sequence of images.
-    void SmartVideoProcessor::ProcessClip(ClipEntry& clipEntry) 
+    ClipStats SmartVideoProcessor::ProcessClip(ClipEntry& clipEntry) 
     {
+        auto start = chrono::steady_clock::now();
+
         // initialize
         InitProcessing(&clipEntry);
 
-        // iterate over all files:
-        for (iNextProcessFrame = clipEntry.StartFrame; iNextProcessFrame < clipEntry.GetFrameCount(); ++iNextProcessFrame)
+        ClipStats stats;
+        stats.Name = clipEntry.Name;
+        stats.FrameCount = GetProcessFrameCount();
+
+        if (isPipelined)
         {
-            // process image
-            ProcessNextFrame();
+            ProcessFramesPipelined();
+        }
+        else
+        {
+            // iterate over all files:
+            for (iNextProcessFrame = clipEntry.StartFrame; iNextProcessFrame < nFrameCount; ++iNextProcessFrame)
+            {
+                // process image
+                ProcessNextFrame();
+            }
         }
 
         // smooth weight vector
@@ -176,6 +379,10 @@ namespace SmartVideo
 
         // finalize the process
         FinishProcessing();
+
+        auto millis = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+        stats.Seconds = millis / 1000.f;
+        return stats;
     }
 
 
@@ -194,6 +401,53 @@ namespace SmartVideo
 
         // draw progress
         UpdateDisplay(info);
+
+        // dump masks and recycle buffers
+        frameOutBuffer.Push(std::move(info));
+    }
+
+
+    void SmartVideoProcessor::ProcessFramesPipelined()
+    {
+        JobIndex nFrames = GetProcessFrameCount();
+
+        // every stage handles all frames in order, and then returns
+        stagePool.Submit(std::bind(&SmartVideoProcessor::RunTrackingStage, this, nFrames));
+        stagePool.Submit(std::bind(&SmartVideoProcessor::RunWeightStage, this, nFrames));
+
+        // background subtraction is the first stage
+        for (iNextProcessFrame = clipEntry->StartFrame; iNextProcessFrame < nFrameCount; ++iNextProcessFrame)
+        {
+            FrameInfo info = frameInBuffer.Pop();
+            BackgroundSubtraction(info);
+            trackingQueue.Push(std::move(info));
+        }
+
+        // wait for the last frame to leave the pipeline
+        stagePool.Join();
+    }
+
+
+    void SmartVideoProcessor::RunTrackingStage(JobIndex nFrames)
+    {
+        for (JobIndex i = 0; i < nFrames; ++i)
+        {
+            FrameInfo info = trackingQueue.Pop();
+            ObjectTracking(info);
+            weightQueue.Push(std::move(info));
+        }
+    }
+
+
+    void SmartVideoProcessor::RunWeightStage(JobIndex nFrames)
+    {
+        for (JobIndex i = 0; i < nFrames; ++i)
+        {
+            FrameInfo info = weightQueue.Pop();
+            SetWeight(info.FrameIndex, ComputeFrameWeight(info));
+            UpdateDisplay(info);
+            frameOutBuffer.Push(std::move(info));
+        }
     }
 
 
@@ -205,7 +459,7 @@ namespace SmartVideo
             info.Frame = tmp;*/
 
             //update the background model
-            pMOG->operator()(info.Frame, info.FrameForegroundMask, Config.LearningRate);
+            backgroundModel->Apply(info.AnalysisFrame, info.FrameForegroundMask, Config.LearningRate);
         }
     }
 
@@ -325,7 +579,21 @@ namespace SmartVideo
 
     void SmartVideoProcessor::InitObjectTracking() {
         prevObject.clear();
+        matchDuals.clear();
+        groupMatcher.clear();
+        trackStore.Clear();
         curObject.clear();
+        incrementalClustering.reset();
+
+        // erode and dilate to get rid of noises?
+        const int ErosionSize = 1;
+        const int DilateSize = 2;
+        erosionKernel = getStructuringElement(MORPH_ELLIPSE,
+            Size(2*ErosionSize+1,2*ErosionSize+1),
+            Point(ErosionSize,ErosionSize));
+        dilateKernel = getStructuringElement(MORPH_ELLIPSE,
+            Size(2*DilateSize+1,2*DilateSize+1),
+            Point(DilateSize,DilateSize));
     }
     void SmartVideoProcessor::ObjectTracking(FrameInfo &frameInfo) {
         if(true/*!Config.UseCachedForObjectDetection*/) {
@@ -335,16 +603,8 @@ namespace SmartVideo
             Mat fgmask = frameInfo.FrameForegroundMask;
             //cv::cvtColor(fgmask, fgmask, CV_BGR2GRAY); // convert to greyscale
 
-            // erode and dilate to get rid of noises?
-            const int ErosionSize = 1;
-            const int DilateSize = 2;
-            Mat erosionKernel = getStructuringElement(MORPH_ELLIPSE,
-                Size(2*ErosionSize+1,2*ErosionSize+1),
-                Point(ErosionSize,ErosionSize));
+            // erode and dilate to get rid of noises? (kernels are made by InitObjectTracking)
             erode(fgmask, fgmask, erosionKernel);
-            Mat dilateKernel = getStructuringElement(MORPH_ELLIPSE,
-                Size(2*DilateSize+1,2*DilateSize+1),
-                Point(DilateSize,DilateSize));
             dilate(fgmask, fgmask, dilateKernel);
 
             // hierarchical clustering
@@ -356,18 +616,60 @@ namespace SmartVideo
             curCluster--;
             }*/
 
-            const double dthreshold = 30.0; // FIXME: what are better options?
-            const int cthreshold = 64; //25;
-
-            vector<Agglomerative::Point2D> pix;
-            Mat nzPixels;
-            findNonZero(fgmask, nzPixels);
-            for(int i=0; i<nzPixels.size().height; i++)
-                pix.push_back(Agglomerative::Point2D(nzPixels.at<Point>(i).y,nzPixels.at<Point>(i).x));
-            Agglomerative::AgglomerativeClustering agc(pix);
-            vector<Agglomerative::Result> agcResult = agc.cluster(dthreshold,cthreshold);
+            // thresholds are in full-resolution pixels
+            const int scale = Config.AnalysisScale;
+            const double dthreshold = 30.0 / scale; // FIXME: what are better options?
+            const int cthreshold = max(64 / (scale * scale), 1); //25;
+
+            // Establish currentObjects, re-using the objects of the frame before last (see the swap below) and their color buffers
+            auto resetObjects = [this](size_t n) {
+                curObject.resize(n);
+                for(auto& obj: curObject) obj.reset();
+            };
+            if(Config.ClusteringEngine == "runs") {
+                // label runs of the mask, without collecting pixels
+                runClustering.cluster(fgmask.ptr<uchar>(0), fgmask.rows, fgmask.cols, fgmask.step, dthreshold, cthreshold);
+                resetObjects(runClustering.getClusterCount());
+                for(auto& run: runClustering.getRuns()) {
+                    if(run.id>=0) curObject[run.id].addRun(run.row,run.begin,run.end);
+                }
+                frameInfo.fgArea = runClustering.getForegroundArea() * scale * scale;
+            } else {
+                vector<Agglomerative::Point2D>& pix = fgPixels;
+                pix.clear();
+                findNonZero(fgmask, nzPixels);
+                for(size_t i=0; i<nzPixels.size(); i++)
+                    pix.push_back(Agglomerative::Point2D(nzPixels[i].y,nzPixels[i].x));
+                if(Config.ClusteringEngine == "incremental") {
+                    // seed with the objects of the previous frame
+                    incrementalClustering.clearSeeds();
+                    for(auto& po: prevObject) {
+                        incrementalClustering.addSeed(po.x1/scale,po.y1/scale,po.x2/scale,po.y2/scale);
+                    }
+                    agcResult = incrementalClustering.cluster(pix,dthreshold,cthreshold);
+                } else {
+                    Agglomerative::AgglomerativeClustering agc(pix);
+                    if(Config.MaxClusterPoints > 0 && static_cast<int>(pix.size()) > Config.MaxClusterPoints) {
+                        agcResult = agc.clusterApproximate(dthreshold,cthreshold,Config.MaxClusterPoints);
+                    } else if(clusterPool) {
+                        agcResult = agc.clusterParallel(dthreshold,cthreshold,*clusterPool);
+                    } else {
+                        agcResult = agc.cluster(dthreshold,cthreshold);
+                    }
+                }
+                int nObjects = 0;
+                for(auto& a: agcResult) nObjects = max(nObjects, a.id+1);
+                resetObjects(nObjects);
+                for(auto& a: agcResult) {
+                    curObject[a.id].addPixel(a.pt.x,a.pt.y);
+                }
+                frameInfo.fgArea = nzPixels.size() * scale * scale;
+            }
 
-            Mat3f clmask = Mat3f(fgmask.size().height, fgmask.size().width, Vec3f(0.0,0.0,0.0));
+            // re-use the (pooled) object mask
+            Mat& clmask = frameInfo.FrameObjectDetection;
+            clmask.create(fgmask.size(), CV_32FC3);
+            clmask.setTo(Scalar::all(0));
             //cv::cvtColor(fgmask, frameInfo.FrameObjectDetection, CV_GRAY2RGB); // convert to greyscale
             // FIXME: autogenerate this later!
             /*const int maxColor = 9;
@@ -379,20 +681,39 @@ namespace SmartVideo
             clmask.at<Vec3f>(a.pt.x, a.pt.y) = color[a.id];
             }*/
 
-            // Establish currentObjects
-            curObject.clear();
-            for(auto& a: agcResult) {
-                if(a.id>=curObject.size()) curObject.resize(a.id+1);
-                curObject[a.id].addPixel(a.pt.x,a.pt.y);
-            }
             for(auto& obj: curObject) {
                 obj.statistics();
+                obj.scale(scale);
             }
-            vector<vector<int>> adj(prevObject.size());
+            adj.resize(prevObject.size());
+            for(auto& a: adj) a.clear();
             //if(prevObject.size()) { // only do matching if previous objects are present
-            Matcher::ClusterMatcher cm(Matcher::obj2cinfo(prevObject), Matcher::obj2cinfo(curObject));
-            vector<pair<int,int>> matching;
-            frameInfo.matchingCost = cm.solve(matching);
+            Matcher::obj2cinfo(prevObject, prevInfo);
+            bool isKalman = Config.MotionModel == "kalman";
+            if(isKalman) {
+                // match against where the objects should be by now, and only within a few standard deviations
+                trackStore.Predict();
+                const Tracking::KalmanTracks& motion = trackStore.GetMotion();
+                for(int i=0; i<static_cast<int>(prevInfo.size()); i++) {
+                    prevInfo[i].x = static_cast<int>(floor(motion.GetX(i) + 0.5f));
+                    prevInfo[i].y = static_cast<int>(floor(motion.GetY(i) + 0.5f));
+                    prevInfo[i].gate2 = Config.KalmanGate * Config.KalmanGate * motion.GetInnovationVariance(i);
+                }
+            }
+            Matcher::obj2cinfo(curObject, curInfo);
+            Matcher::ClusterMatcher& cm = clusterMatcher;
+            cm.setObjects(prevInfo, curInfo);
+            if(Config.MatchingThreads > 0) {
+                Matcher::MatchMethod method = Config.MatcherMode == "sparse" ? Matcher::MatchMethod::Sparse : 
+                    Config.MatcherMode == "flow" ? Matcher::MatchMethod::Flow : Matcher::MatchMethod::Dense;
+                frameInfo.matchingCost = groupMatcher.solve(cm, matching, Config.MatchGate, method);
+            } else if(Config.MatcherMode == "sparse") {
+                frameInfo.matchingCost = cm.solveSparse(matching, Config.MatchGate, sparseAssignment);
+            } else if(Config.MatcherMode == "flow") {
+                frameInfo.matchingCost = cm.solveFlow(matching, minCostFlow);
+            } else {
+                frameInfo.matchingCost = cm.solve(matching, hungarian, matchDuals);
+            }
             // associate related pairs
             for(auto rel: matching) {
                 int pv = rel.first;
@@ -400,6 +721,8 @@ namespace SmartVideo
                 adj[pv].push_back(cv);
             }
             //}
+            // continue the tracks (and write them, if the track file is open)
+            trackStore.Update(frameInfo.FrameIndex, matching, curObject);
             for(int i=0; i<prevObject.size(); i++) {
                 if(adj[i].size() == 0) continue; // dead-end cluster
                 const auto& po = prevObject[i];
@@ -417,23 +740,22 @@ namespace SmartVideo
             // record frame weight informatinos
             frameInfo.numObject = curObject.size();
             frameInfo.matchingCost; // recorded in the section of hungarian matching
-            frameInfo.fgArea = nzPixels.size().height;
 
             //frameInfo.FrameObjectDetection = frameInfo.Frame*0.2;
-            /*for(int i=0; i<nzPixels.size().height; i++) {
-                int r = nzPixels.at<Point>(i).y;
-                int c = nzPixels.at<Point>(i).x;
+            /*for(int i=0; i<nzPixels.size(); i++) {
+                int r = nzPixels[i].y;
+                int c = nzPixels[i].x;
                 //frameInfo.FrameObjectDetection.at<Vec3s>(r,c) *= 3;
             }*/
             // draw bounding boxes
-            for(auto co: curObject) {
+            for(auto& co: curObject) {
                 ColorProfile cp = co.avgColor();
-                rectangle(clmask, Point(co.y1,co.x1), Point(co.y2,co.x2), Scalar(cp.r,cp.g,cp.b), 2);
+                rectangle(clmask, Point(co.y1/scale,co.x1/scale), Point(co.y2/scale,co.x2/scale), Scalar(cp.r,cp.g,cp.b), 2);
                 //rectangle(frameInfo.FrameObjectDetection, Point(co.y1,co.x1), Point(co.y2,co.x2), Scalar(cp.r,cp.g,cp.b), 2);
             }
-            frameInfo.FrameObjectDetection = clmask;
 
-            prevObject = curObject;
+            // the old previous objects are re-used by the next frame
+            swap(prevObject, curObject);
 
         }
     }
@@ -503,9 +825,17 @@ namespace SmartVideo
     {
         stringstream strstr;
         string statusString;
-        strstr << " -- input buffer: " << frameInBuffer.GetSize() << "/" << Config.MaxIOQueueSize << "";
+        strstr << " -- input buffer: " << frameInBuffer.GetSize() << "/" << frameInBuffer.GetCapacity() << "";
+        if (isPipelined)
+        {
+            strstr << " -- stages: " << trackingQueue.GetSize() << "/" << weightQueue.GetSize();
+        }
+        strstr << " -- output: " << frameWriter.GetQueueSize();
         statusString = strstr.str();
-        progressBar.UpdateProgress(info.FrameIndex, statusString);
+        if (Config.ShowProgress)
+        {
+            progressBar.UpdateProgress(info.FrameIndex, statusString);
+        }
         
         if (Config.DisplayFrames)
         {
@@ -524,49 +854,27 @@ namespace SmartVideo
 
             waitKey(12);        // TODO: Add a way to better control FPS
         }
+    }
 
-        // Dump the foreground information
-        std::string outfile = Config.GetForegroundFolder(*clipEntry) + "/" + info.FrameName + "." + Config.CachedImageType;  // save as CachedImageType
-        try 
-        {
-            MkDir(Config.GetForegroundFolderBase(*clipEntry));        // make sure that folder exists
-            MkDir(Config.GetForegroundFolder(*clipEntry));        // make sure that folder exists
-            bool saved = imwrite(outfile, info.FrameForegroundMask);
-            if (!saved) 
-            {
-                cerr << "Unable to save " << outfile << endl;
-            }
-        } 
 
-        catch (runtime_error& ex) 
+    void SmartVideoProcessor::StartFrameWriter()
+    {
+        if (Config.CachedImageType == "rle")
         {
-            cerr << "Exception dumping foreground image in ." << Config.CachedImageType << " format: " << ex.what() << endl;
-            cerr << "Press ENTER to exit." << endl; cin.get();
-            exit(EXIT_FAILURE);
+            // all masks go into one archive
+            MkDir(Config.GetMaskFolderBase(*clipEntry));
+            frameWriter.StartArchive(frameOutBuffer, Config.GetMaskArchivePath(*clipEntry), clipEntry->StartFrame, GetProcessFrameCount(), Config.WriterBatchSize);
+            return;
         }
 
-        // Dump the object frame
-        outfile = Config.GetMaskFolder(*clipEntry) + "/" + info.FrameName + "." + Config.CachedImageType;  // save as CachedImageType
-        try 
-        {
-            MkDir(Config.GetMaskFolderBase(*clipEntry));        // make sure that folder exists
-            MkDir(Config.GetMaskFolder(*clipEntry));        // make sure that folder exists
-            Mat outmat;
-            info.FrameObjectDetection.convertTo(outmat,CV_8U,255.0);
-            bool saved = imwrite(outfile, outmat);
-            if (!saved) 
-            {
-                cerr << "Unable to save " << outfile << endl;
-            }
-        } 
-
-        catch (runtime_error& ex) 
-        {
-            cerr << "Exception dumping object tracking mask in ." << Config.CachedImageType << " format: " << ex.what() << endl;
-            cerr << "Press ENTER to exit." << endl; cin.get();
-            exit(EXIT_FAILURE);
-        }
+        // make sure that folders exist
+        MkDir(Config.GetForegroundFolderBase(*clipEntry));
+        MkDir(Config.GetForegroundFolder(*clipEntry));
+        MkDir(Config.GetMaskFolderBase(*clipEntry));
+        MkDir(Config.GetMaskFolder(*clipEntry));
 
+        frameWriter.Start(frameOutBuffer, Config.GetForegroundFolder(*clipEntry), Config.GetMaskFolder(*clipEntry), 
+            Config.CachedImageType, Config.WriterBatchSize);
     }
 
 
@@ -576,7 +884,6 @@ namespace SmartVideo
 
         iFrame += clipEntry->StartFrame;
         
-        auto nFrameCount = clipEntry->GetFrameCount();
         if (iFrame >= nFrameCount)
         {
             return false;
@@ -590,17 +897,24 @@ namespace SmartVideo
         }
         
 
+        // don't read frames that do not fit into the input buffer yet
+        if (!frameInBuffer.WaitForSlot(iFrame))
+        {
+            return false;
+        }
+
         FrameInfo frameInfo(iFrame);
         frameInfo.FrameName = ToString(iFrame);
+        frameInfo.UseBuffers(framePool.Acquire());
         if (clipEntry->Type == ClipType::Video)
         {
             // read frame from video
-            if (!clipEntry->Video.read(frameInfo.Frame) || frameInfo.Frame.total() == 0)
-            {
-                cerr << "ERROR: Unable to read next frame (#" << frameInfo.FrameIndex << ") from video." << endl;
-                cerr << "Press ENTER to exit." << endl; cin.get();
-                exit(EXIT_FAILURE);
-            }
+            ReadVideoFrame(clipEntry->Video, frameInfo);
+        }
+        else if (frameCache.IsReadable())
+        {
+            // view into the cache
+            frameInfo.Frame = frameCache.GetFrame(iFrame);
         }
         else
         {
@@ -609,7 +923,15 @@ namespace SmartVideo
             auto fname = *(clipEntry->Filenames.begin() + iFrame);
             string fpath = folder + "/" + fname;
 
-            frameInfo.Frame = imread(fpath);
+            // decode into the (pooled) frame buffer
+            if (ReadBytes(fpath, frameInfo.Buffers.EncodedFrame))
+            {
+                imdecode(frameInfo.Buffers.EncodedFrame, CV_LOAD_IMAGE_COLOR, &frameInfo.Frame);
+            }
+            else
+            {
+                frameInfo.Frame.release();
+            }
             if(!frameInfo.Frame.data)
             {
                 // error in opening an image file
@@ -617,14 +939,102 @@ namespace SmartVideo
                 cerr << "Press ENTER to exit." << endl; cin.get();
                 exit(EXIT_FAILURE);
             } 
+
+            if (frameCache.IsWriting())
+            {
+                frameCache.PutFrame(iFrame, frameInfo.Frame);
+            }
         }
 
+        DownsampleFrame(frameInfo);
+
         // add image to queue
-        frameInBuffer.Push(frameInfo);
+        if (!frameInBuffer.Push(iFrame, std::move(frameInfo)))
+        {
+            ReleaseFrame(frameInfo);
+            return false;
+        }
         return true;
     }
 
 
+    bool SmartVideoProcessor::ReadNextVideoSegment(JobIndex iSegment)
+    {
+        JobIndex iFirstFrame = clipEntry->StartFrame + iSegment * Config.VideoSegmentLength;
+        if (iFirstFrame >= nFrameCount)
+        {
+            return false;
+        }
+        JobIndex iEndFrame = min<JobIndex>(iFirstFrame + Config.VideoSegmentLength, nFrameCount);
+
+        // don't start decoding before the segment fits into the input buffer
+        if (!frameInBuffer.WaitForSlot(iFirstFrame))
+        {
+            return false;
+        }
+
+        // every segment gets its own capture, so readers never share decoder state
+        auto fname = Config.GetVideoFile(*clipEntry);
+        VideoCapture video(fname);
+        if (!video.isOpened())
+        {
+            cerr << "Unable to open video file: " << fname << endl;
+            cerr << "Press ENTER to exit." << endl; cin.get();
+            exit(EXIT_FAILURE);
+        }
+
+        // the decoder seeks to the closest keyframe before the segment and decodes forward from there
+        video.set(CV_CAP_PROP_POS_FRAMES, iFirstFrame);
+
+        for (JobIndex iFrame = iFirstFrame; iFrame < iEndFrame; ++iFrame)
+        {
+            if (!frameInBuffer.WaitForSlot(iFrame))
+            {
+                return false;
+            }
+
+            FrameInfo frameInfo(iFrame);
+            frameInfo.FrameName = ToString(iFrame);
+            frameInfo.UseBuffers(framePool.Acquire());
+            ReadVideoFrame(video, frameInfo);
+            DownsampleFrame(frameInfo);
+
+            if (!frameInBuffer.Push(iFrame, std::move(frameInfo)))
+            {
+                ReleaseFrame(frameInfo);
+                return false;
+            }
+        }
+        return true;
+    }
+
+
+    void SmartVideoProcessor::ReadVideoFrame(VideoCapture& video, FrameInfo& frameInfo)
+    {
+        if (!video.read(frameInfo.Frame) || frameInfo.Frame.total() == 0)
+        {
+            cerr << "ERROR: Unable to read next frame (#" << frameInfo.FrameIndex << ") from video." << endl;
+            cerr << "Press ENTER to exit." << endl; cin.get();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+
+    void SmartVideoProcessor::DownsampleFrame(FrameInfo& frameInfo)
+    {
+        if (Config.AnalysisScale > 1)
+        {
+            // averages every block of pixels, on the reader's thread (writes into the pooled buffer, if any)
+            Size analysisSize = FramePool::GetAnalysisSize(frameInfo.Frame.cols, frameInfo.Frame.rows, Config.AnalysisScale);
+            resize(frameInfo.Frame, frameInfo.AnalysisFrame, analysisSize, 0, 0, INTER_AREA);
+        }
+        else
+        {
+            frameInfo.AnalysisFrame = frameInfo.Frame;
+        }
+    }
+
+
     void SmartVideoProcessor::Cleanup()
     {
         if (Config.DisplayFrames)
@@ -634,7 +1044,28 @@ namespace SmartVideo
             cvDestroyWindow("Object");
         }
 
+        frameInBuffer.Close();
         ioPool.Stop();
         ioPool.Join();
+        frameWriter.Finish();
+        ReleaseQueuedFrames();
+    }
+
+
+    void SmartVideoProcessor::ReleaseFrame(FrameInfo& info)
+    {
+        info.ReleaseMats();
+        framePool.Release(std::move(info.Buffers));
+    }
+
+
+    void SmartVideoProcessor::ReleaseQueuedFrames()
+    {
+        // frames of an aborted clip are still holding pooled buffers
+        auto release = [this](FrameInfo& info) { ReleaseFrame(info); };
+        frameInBuffer.Reset(frameInBuffer.GetNextIndex(), 0, release);
+        trackingQueue.Clear(release);
+        weightQueue.Clear(release);
+        frameOutBuffer.Clear(release);
     }
 }
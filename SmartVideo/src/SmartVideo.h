@@ -5,8 +5,19 @@
 #include "ConsoleUtil.h"
 #include "JSonUtil.h"
 #include "Workers.h"
+#include "backgroundModel.h"
 #include "agglomerative.h"
+#include "runClustering.h"
+#include "incrementalClustering.h"
 #include "matcher.h"
+#include "hungarian.h"
+#include "assignment.h"
+#include "minCostFlow.h"
+#include "groupMatcher.h"
+#include "trackStore.h"
+#include "frameCache.h"
+#include "framePool.h"
+#include "frameWriter.h"
 
 #include "opencv2/ml/ml.hpp"
 #include "opencv2/flann/flann.hpp"
@@ -72,10 +83,34 @@ namespace SmartVideo
 
         // SmartVideoProcessor-specific configuration
         bool DisplayFrames;
+        /// Draw a progress bar to the console (should be off, if multiple clips are processed at once)
+        bool ShowProgress;
         int ProgressBarLen;
         int MaxIOQueueSize;
         int NReadThreads;
 
+        /// If > 0, every read thread decodes its own segment of this many frames from a video,
+        /// using its own VideoCapture. Otherwise, a single thread reads the whole video.
+        /// Should be a multiple of the video's keyframe interval, since every segment starts with a seek.
+        /// Note that the input buffer grows to hold NReadThreads segments.
+        int VideoSegmentLength;
+
+        /// Run tracking, weight accounting and mask output on their own threads, 
+        /// connected by bounded queues of StageQueueSize frames each.
+        /// Background subtraction stays on the processing thread.
+        bool PipelineStages;
+        int StageQueueSize;
+
+        /// Maximum amount of frames that the mask writer encodes and writes at once
+        int WriterBatchSize;
+        /// Maximum amount of frames waiting for the mask writer (defaults to two batches)
+        int WriterQueueSize;
+
+        /// Amount of clips that are processed at the same time, each by its own processor
+        int ParallelClips;
+        /// Total amount of threads to be shared by all processors and OpenCV (0 = amount of cores)
+        int ThreadBudget;
+
         // Data configuration
         std::string CfgFolder;
         std::string CfgFile;
@@ -93,10 +128,57 @@ namespace SmartVideo
         std::string ForegroundDir;
         std::string MaskDir;
 
+        /// Back pooled frame buffers with large (huge) pages, if the OS allows it
+        bool UseLargePages;
+
         double LearningRate;
+        /// Background subtraction: "mog" (default, OpenCV's mixture of Gaussians), or "gaussian" (one running Gaussian per pixel,
+        /// in vectorized fixed point, see GaussianBackgroundModel). The gaussian model marks pixels that are more than
+        /// BackgroundThreshold standard deviations away from the mean as foreground (default: 2.5).
+        std::string BackgroundEngine;
+        double BackgroundThreshold;
+        /// Frames are downsampled by this factor right after reading, and background subtraction, morphology and clustering
+        /// run at that resolution (default: 1). Object coordinates and areas (and so frame weights, matching and tracks)
+        /// are scaled back to full resolution. Masks are upsampled only when they are dumped.
+        int AnalysisScale;
+
+        /// Clustering of foreground pixels into objects: "agglomerative" (default), "runs" (see RunLengthClustering),
+        /// or "incremental" (see IncrementalClustering)
+        std::string ClusteringEngine;
+        /// Incremental clustering re-clusters from scratch after this many frames,
+        /// or if more than this ratio of foreground pixels is not covered by the previous objects
+        int ClusterRefreshInterval;
+        double MaxUnseededRatio;
+        /// If > 1, agglomerative clustering splits every frame into tiles, and clusters them on this many threads
+        int ClusteringThreads;
+        /// If > 0, agglomerative clustering of frames with more foreground pixels than this is approximated
+        /// on at most this many representative pixels, which caps its cost in crowded frames
+        int MaxClusterPoints;
+        /// Matching of objects between frames: "dense" (default, Hungarian method on all pairs), 
+        /// "sparse" (only pairs that moved at most MatchGate pixels, see ClusterMatcher::solveSparse),
+        /// or "flow" (same result as "dense", as a much smaller min-cost flow, see ClusterMatcher::solveFlow)
+        std::string MatcherMode;
+        int MatchGate;
+        /// If > 0, objects are split into groups that cannot be linked across (see ClusterMatcher::decompose, which uses MatchGate
+        /// in all modes), and every group is matched on its own, by this many threads
+        int MatchingThreads;
+        /// Motion of objects: "none" (default, match against the last position), or "kalman" (match against the
+        /// position predicted by a constant-velocity Kalman filter, and in sparse mode, only within KalmanGate
+        /// standard deviations of it). Noise values are variances, in pixels (per frame).
+        std::string MotionModel;
+        double KalmanProcessNoise;
+        double KalmanMeasurementNoise;
+        double KalmanGate;
+        /// Stream the bounding box, centroid and area of every object, with stable track IDs, into a track file
+        /// next to the weights file (see TrackStore)
+        bool WriteTracks;
         std::string CachedImageType;
         bool UseCachedForForeground;
 
+        /// Decoded frames of image sequences are cached in one file per clip, and memory-mapped on later runs
+        bool UseFrameCache;
+        std::string FrameCacheDir;
+
         std::vector<ClipEntry> ClipEntries;
 
         /// Amount of frames in this clip
@@ -124,6 +206,12 @@ namespace SmartVideo
             return CfgFolder + "/" + ClipinfoDir + "/" + clipEntry.Name + "-sequence";
         }
 
+        /// Get the path to the file containing the tracks of all objects of the given clip (if WriteTracks is set)
+        std::string GetTrackFilePath(const ClipEntry& clipEntry) const
+        {
+            return CfgFolder + "/" + ClipinfoDir + "/" + clipEntry.Name + "-tracks.bin";
+        }
+
         /// Get the path to the file containing all frame filenames.
         std::string GetFrameFilePath(const ClipEntry& clipEntry) const
         {
@@ -166,12 +254,31 @@ namespace SmartVideo
             return CfgFolder + "/" + DataFolder + "/" + MaskDir;
         }
 
+        /// Get the path of the run-length encoded archive holding all masks of the given clip (if CachedImageType is "rle")
+        std::string GetMaskArchivePath(const ClipEntry& clipEntry) const
+        {
+            return GetMaskFolderBase(clipEntry) + "/" + clipEntry.Name + ".masks";
+        }
+
+        /// Get the folder containing the frame caches
+        std::string GetFrameCacheFolder() const
+        {
+            return CfgFolder + "/" + DataFolder + "/" + FrameCacheDir;
+        }
+
+        /// Get the path to the file containing all decoded frames of the given clip
+        std::string GetFrameCachePath(const ClipEntry& clipEntry) const
+        {
+            return GetFrameCacheFolder() + "/" + clipEntry.Name + ".frames";
+        }
+
         /// Read all config files
         virtual bool InitializeConfig();
     };
 
 
     /// Data and meta-data of a frame, to be stored in frame buffer.
+    /// Can only be moved, not copied, while passing through the pipeline.
     struct FrameInfo
     {
         std::string FrameName;
@@ -179,43 +286,148 @@ namespace SmartVideo
         Util::JobIndex FrameIndex;
         /// Frame data
         cv::Mat Frame;
-        /// Binary image, with only foreground set to 1
+        /// Frame at analysis resolution (shares its data with Frame, if SmartVideoConfig::AnalysisScale is 1)
+        cv::Mat AnalysisFrame;
+        /// Binary image, with only foreground set to 1 (at analysis resolution)
         cv::Mat FrameForegroundMask;
-        /// Object frame
+        /// Object frame (at analysis resolution)
         cv::Mat FrameObjectDetection;
 
         /// Informations for calculation of frame weight
         int numObject;
         double fgArea, matchingCost;
 
-        FrameInfo(Util::JobIndex frameIndex) : FrameIndex(frameIndex) {}
+        /// Pooled memory backing the Mats above (if any). Must be returned to the pool when done.
+        FrameBuffers Buffers;
+
+        FrameInfo(Util::JobIndex frameIndex = 0) : 
+            FrameIndex(frameIndex),
+            numObject(0),
+            fgArea(0),
+            matchingCost(0)
+        {
+        }
+
+        FrameInfo(FrameInfo&& other) :
+            FrameName(std::move(other.FrameName)),
+            FrameIndex(other.FrameIndex),
+            Frame(other.Frame),
+            AnalysisFrame(other.AnalysisFrame),
+            FrameForegroundMask(other.FrameForegroundMask),
+            FrameObjectDetection(other.FrameObjectDetection),
+            numObject(other.numObject),
+            fgArea(other.fgArea),
+            matchingCost(other.matchingCost),
+            Buffers(std::move(other.Buffers))
+        {
+            other.ReleaseMats();
+        }
+
+        FrameInfo& operator=(FrameInfo&& other)
+        {
+            if (this != &other)
+            {
+                FrameName = std::move(other.FrameName);
+                FrameIndex = other.FrameIndex;
+                Frame = other.Frame;
+                AnalysisFrame = other.AnalysisFrame;
+                FrameForegroundMask = other.FrameForegroundMask;
+                FrameObjectDetection = other.FrameObjectDetection;
+                numObject = other.numObject;
+                fgArea = other.fgArea;
+                matchingCost = other.matchingCost;
+                Buffers = std::move(other.Buffers);
+                other.ReleaseMats();
+            }
+            return *this;
+        }
+
+        /// Let all Mats of this frame use the given (pooled) buffers.
+        void UseBuffers(FrameBuffers buffers)
+        {
+            Buffers = std::move(buffers);
+            Frame = Buffers.Frame;
+            AnalysisFrame = Buffers.AnalysisFrame;
+            FrameForegroundMask = Buffers.ForegroundMask;
+            FrameObjectDetection = Buffers.ObjectMask;
+        }
+
+        /// Drop all references to frame data.
+        void ReleaseMats()
+        {
+            Frame.release();
+            AnalysisFrame.release();
+            FrameForegroundMask.release();
+            FrameObjectDetection.release();
+        }
 
         bool operator<(const FrameInfo& other) const
         {
             return FrameIndex < other.FrameIndex;
         }
+
+    private:
+        /// Disallow copy ctor
+        FrameInfo(const FrameInfo&);
+        FrameInfo& operator=(const FrameInfo&);
+    };
+
+
+    /// Timing of one processed clip.
+    struct ClipStats
+    {
+        std::string Name;
+        Util::JobIndex FrameCount;
+        float Seconds;
+
+        ClipStats() : FrameCount(0), Seconds(0) {}
+
+        /// Processed frames per second
+        float GetFps() const { return Seconds > 0 ? FrameCount / Seconds : 0; }
     };
 
 
     /// The class that does the "SmartVideo" processing.
     struct SmartVideoProcessor
     {
-        const SmartVideoConfig Config;
+        /// Amount of stages that run on stagePool (tracking, weight)
+        static const int NPipelineStages = 2;
+
+        /// Shared by all processors, and must outlive them
+        const SmartVideoConfig& Config;
 
         ClipEntry * clipEntry;                        // current clip
-        /// Stores frames read from disk
-        Util::ThreadSafeQueue<FrameInfo> frameInBuffer;
-        /// Stores frames to be written back to disk
+        /// Stores frames read from disk, in order of their FrameIndex
+        Util::ReorderBuffer<FrameInfo> frameInBuffer;
+        /// Frames between the pipeline stages (if pipelined)
+        Util::ThreadSafeQueue<FrameInfo> trackingQueue, weightQueue;
+        /// Stores frames to be written back to disk, until dumped by frameWriter
         Util::ThreadSafeQueue<FrameInfo> frameOutBuffer;
 
         /// Index of next frame to be processed
         Util::JobIndex iNextProcessFrame;
-        std::unique_ptr<cv::BackgroundSubtractor> pMOG;     // MOG Background subtractor
+        /// Amount of frames of the current clip (read once, so readers don't have to query a shared VideoCapture)
+        Util::JobIndex nFrameCount;
+        std::unique_ptr<BackgroundModel> backgroundModel;   // Background subtractor (see SmartVideoConfig::BackgroundEngine)
         std::vector<double> frameWeights;                    // weight of every frame
         std::vector<int> playbackSequence;                  // list of frames to play
 
-        /// WorkerPool for multi-threaded I/O
+        /// Decoded frames of the current clip (if enabled)
+        FrameCache frameCache;
+
+        /// Recycled buffers of all frames in flight
+        FramePool framePool;
+
+        /// WorkerPool for multi-threaded I/O (workers persist across clips)
         Util::WorkerPool ioPool;
+
+        /// Dumps masks of all processed frames
+        FrameWriter frameWriter;
+
+        /// Runs one long-lived task per pipeline stage
+        Util::WorkerPool stagePool;
+        /// Whether the current clip is processed by the stage pipeline
+        bool isPipelined;
         
         /// Progress bar used for showing progress in Console.
         Util::ConsoleProgressBar progressBar;
@@ -223,13 +435,58 @@ namespace SmartVideo
         /// Object vector information needed for ObjectTracking
         vector<ObjectProfile> prevObject, curObject;
 
-        SmartVideoProcessor(SmartVideoConfig cfg) :
+        /// Buffers re-used by ObjectTracking for every frame
+        cv::Mat erosionKernel, dilateKernel;
+        std::vector<cv::Point> nzPixels;
+        std::vector<Agglomerative::Point2D> fgPixels;
+        std::vector<Agglomerative::Result> agcResult;
+        std::vector<Matcher::ClusterInfo> prevInfo, curInfo;
+        std::vector<std::pair<int,int>> matching;
+        std::vector<std::vector<int>> adj;
+        Matcher::ClusterMatcher clusterMatcher;
+        Agglomerative::RunLengthClustering runClustering;
+        Agglomerative::IncrementalClustering incrementalClustering;
+        Hungarian::HungarianMethod hungarian;
+        /// Labels of the last frame's matching, to warm-start the next one
+        Matcher::MatchDuals matchDuals;
+        /// Tracks of the objects (IDs and motion), and the track file of the current clip
+        TrackStore trackStore;
+        Assignment::SparseAssignment sparseAssignment;
+        Flow::MinCostFlow minCostFlow;
+        /// Workers for tile-parallel clustering (if enabled)
+        std::unique_ptr<Util::WorkerPool> clusterPool;
+        /// Workers for matching groups of objects in parallel (if enabled)
+        std::unique_ptr<Util::WorkerPool> matchPool;
+        /// Matches groups of objects separately (if MatchingThreads > 0), on the workers of matchPool (if any)
+        Matcher::GroupMatcher groupMatcher;
+
+        SmartVideoProcessor(const SmartVideoConfig& cfg) :
             Config(cfg),
             clipEntry(nullptr),
-            frameInBuffer(cfg.MaxIOQueueSize, true, std::bind(&SmartVideoProcessor::IsNextInputFrame, this, std::placeholders::_1)),
-            frameOutBuffer(cfg.MaxIOQueueSize, false),
-            progressBar(cfg.ProgressBarLen)
+            frameInBuffer(cfg.MaxIOQueueSize),
+            trackingQueue(cfg.StageQueueSize),
+            weightQueue(cfg.StageQueueSize),
+            frameOutBuffer(cfg.WriterQueueSize),
+            nFrameCount(0),
+            ioPool(cfg.NReadThreads > 0 ? cfg.NReadThreads : 1),
+            frameWriter(framePool),
+            stagePool(NPipelineStages),
+            isPipelined(false),
+            progressBar(cfg.ProgressBarLen),
+            clusterMatcher(std::vector<Matcher::ClusterInfo>(), std::vector<Matcher::ClusterInfo>()),
+            incrementalClustering(cfg.ClusterRefreshInterval > 0 ? cfg.ClusterRefreshInterval : 30, cfg.MaxUnseededRatio > 0 ? cfg.MaxUnseededRatio : 0.5),
+            trackStore(static_cast<float>(cfg.KalmanProcessNoise > 0 ? cfg.KalmanProcessNoise : 4.0),
+                static_cast<float>(cfg.KalmanMeasurementNoise > 0 ? cfg.KalmanMeasurementNoise : 25.0))
         {
+            if (cfg.ClusteringThreads > 1)
+            {
+                clusterPool = std::unique_ptr<Util::WorkerPool>(new Util::WorkerPool(cfg.ClusteringThreads));
+            }
+            if (cfg.MatchingThreads > 1)
+            {
+                matchPool = std::unique_ptr<Util::WorkerPool>(new Util::WorkerPool(cfg.MatchingThreads));
+            }
+            groupMatcher.setPool(matchPool.get());
         }
 
         virtual ~SmartVideoProcessor()
@@ -253,12 +510,53 @@ namespace SmartVideo
         /// Draw progress. TODO: Trigger event instead, and let user draw.
         void UpdateDisplay(FrameInfo& info);
 
+        /// Create the output folders of the current clip, and start the mask writer.
+        void StartFrameWriter();
+
+        /// Runs all frames of the current clip through the stage pipeline.
+        void ProcessFramesPipelined();
+
+        // Pipeline stages (each runs nFrames frames on its own thread)
+        void RunTrackingStage(Util::JobIndex nFrames);
+        void RunWeightStage(Util::JobIndex nFrames);
+
         /// Release all resources
         void Cleanup();
 
+        /// Return the pooled buffers of the given frame, which is dropped without being processed.
+        void ReleaseFrame(FrameInfo& info);
+
+        /// Drop all frames left in the queues, and return their buffers.
+        /// Make sure that readers, stages and frameWriter are not running anymore before taking this step.
+        void ReleaseQueuedFrames();
+
         /// Task queue for file-reader thread.
         bool ReadNextInputFrame(Util::JobIndex iFrame);
 
+        /// Task queue for segment-wise video reader threads.
+        bool ReadNextVideoSegment(Util::JobIndex iSegment);
+
+        /// Open the frame cache of the current clip, or create it if it does not exist yet.
+        void InitFrameCache();
+
+        /// Allocate buffers for all frames that can be in flight at the same time.
+        void InitFramePool();
+
+        /// Read the first frame of the current clip, to learn about the format of all frames.
+        bool ProbeFrameSize(int& width, int& height);
+
+        /// Amount of frames to be processed in the current clip.
+        Util::JobIndex GetProcessFrameCount() const
+        {
+            return nFrameCount > static_cast<Util::JobIndex>(clipEntry->StartFrame) ? nFrameCount - clipEntry->StartFrame : 0;
+        }
+
+        /// Read next frame from the given video into the given FrameInfo.
+        void ReadVideoFrame(cv::VideoCapture& video, FrameInfo& frameInfo);
+
+        /// Set the AnalysisFrame of a frame that has just been read.
+        void DownsampleFrame(FrameInfo& frameInfo);
+
         // Sub-Procedures for each Part
         void BackgroundSubtraction(FrameInfo& info);
         void InitObjectTracking();
@@ -269,11 +567,6 @@ namespace SmartVideo
         bool ClusterWithK(const cv::Mat& fgmask, int maxCluster, cv::Mat3f& clmask);
 
     public:
-        bool IsNextInputFrame(const FrameInfo& info) const 
-        { 
-            return info.FrameIndex == iNextProcessFrame; 
-        }
-
         /// Set the weight of the given frame.
         void SetWeight(int iFrame, float weight)
         {
@@ -282,7 +575,7 @@ namespace SmartVideo
         }
 
         /// Process a stream that is represented by a sequence of images.
-        void ProcessClip(ClipEntry& clipEntry);
+        ClipStats ProcessClip(ClipEntry& clipEntry);
     };
 }
 
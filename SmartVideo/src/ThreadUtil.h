@@ -4,6 +4,9 @@
 
 #include "Util.h"
 #include <queue>
+#include <atomic>
+#include <memory>
+#include <functional>
 
 namespace Util
 {
@@ -46,113 +49,290 @@ namespace Util
     };
 
 
-    /// Multi-threaded queue for producer/consumer implementation.
+    /// Multi-threaded, bounded FIFO queue for producer/consumer implementation.
     template<typename T>
     class ThreadSafeQueue
     {
     public:
         typedef std::deque<T> Queue;
+        /// Called for every item that is dropped without being consumed
+        typedef std::function<void(T&)> ReleaseCallback;
 
     private:
         std::mutex queueLock;
         Queue queue;
-        std::condition_variable monitor;
+        std::condition_variable notEmpty;
+        std::condition_variable notFull;
         int maxSize;
-        bool sorted;
-
-        std::function<bool(const T&)> nextPredicate;
-        
-
-        /// Check if the queue contains the correct next element.
-        bool ContainsValidElement()
-        {
-            if (!nextPredicate) return true;
-            
-            if (sorted) return nextPredicate(queue.front());
-            else
-            {
-                // iterate over all elements
-                for (auto& el : queue)
-                    if (nextPredicate(el)) return true;
-
-                return false;
-            }
-        }
+        bool isClosed;
 
     public:
-        typedef std::deque<T> Queue;
-        
-        ThreadSafeQueue(int maxSize = 0, bool sorted = false, std::function<bool(const T&)> nextPredicate = nullptr) : 
+        ThreadSafeQueue(int maxSize = 0) : 
             maxSize(maxSize),
-            sorted(sorted),
-            nextPredicate(nextPredicate)
+            isClosed(false)
         {
         }
 
-        int GetSize() const { return queue.size(); }
+        int GetSize() const { return static_cast<int>(queue.size()); }
         
 
-        /// Add object to tail (produce).
-        void Push(const T& obj)
+        /// Add object to tail (produce). Waits, while queue is full.
+        void Push(T obj)
         {
             {
                 // lock while adding object to queue
                 std::unique_lock<std::mutex> lk(queueLock);
 
-                // wait until space is available (or it's a priority item)
-                while (maxSize > 0 && queue.size() >= maxSize-1 && (!nextPredicate || !nextPredicate(obj)))
-                {
-                    // yield timeslice
-                    monitor.wait_for(lk, chrono::milliseconds(16));
-                }
+                // wait until space is available
+                notFull.wait(lk, [this]() { return maxSize <= 0 || static_cast<int>(queue.size()) < maxSize; });
 
-                if (sorted)
-                {
-                    // insert at the right position
-                    Queue::iterator it = queue.begin();
-                    for (; it != queue.end() && (*it) < obj; ++it);
-                    
-                    queue.insert(it, obj);
-                }
-                else
-                {
-                    // insert at the tail
-                    queue.push_back(obj);
-                }
+                queue.push_back(std::move(obj));
             }
+            notEmpty.notify_one();
         }
         
         /// Get and remove from head (consume). Waits, while queue is empty.
         T Pop()
         {
+            std::unique_lock<std::mutex> lk(queueLock);
+
+            // wait until something is available
+            notEmpty.wait(lk, [this]() { return !queue.empty(); });
+                
+            T obj(std::move(queue.front()));
+            queue.pop_front();
+
+            lk.unlock();
+            notFull.notify_one();
+            return obj;
+        }
+
+        /// Moves up to maxCount objects from the head into items (consume). 
+        /// Waits, while queue is empty and not closed.
+        /// Returns false, if the queue has been closed and nothing is left.
+        bool PopBatch(std::vector<T>& items, int maxCount)
+        {
+            items.clear();
             {
-                // lock while removing object from queue
                 std::unique_lock<std::mutex> lk(queueLock);
 
-                // wait until the right thing is available
-                while (queue.empty() || !ContainsValidElement())
+                // wait until something is available
+                notEmpty.wait(lk, [this]() { return !queue.empty() || isClosed; });
+
+                while (!queue.empty() && static_cast<int>(items.size()) < maxCount)
                 {
-                    // yield timeslice
-                    monitor.wait_for(lk, chrono::milliseconds(16));
+                    items.push_back(std::move(queue.front()));
+                    queue.pop_front();
                 }
-                
-                T obj = queue.front();
-                queue.pop_front();
-                
-                return obj;
             }
+            notFull.notify_all();
+            return !items.empty();
+        }
+
+        /// Wakes up all consumers waiting in PopBatch; they return once the queue has been drained.
+        void Close()
+        {
+            {
+                std::unique_lock<std::mutex> lk(queueLock);
+                isClosed = true;
+            }
+            notEmpty.notify_all();
         }
 
-        /// Remove all previously produced items. 
+        /// Remove all previously produced items, and re-open the queue.
+        /// If given, release is called for every removed item first (e.g. to return its resources).
         /// Make sure that producers are not running anymore before taking this step.
-        void Clear()
+        void Clear(const ReleaseCallback& release = ReleaseCallback())
         {
             {
                 // lock while removing object from queue
                 std::unique_lock<std::mutex> lk(queueLock);
 
+                if (release)
+                {
+                    for (auto& obj : queue)
+                    {
+                        release(obj);
+                    }
+                }
                 queue.clear();
+                isClosed = false;
+            }
+            notFull.notify_all();
+        }
+    };
+
+
+    /// Bounded reorder window for multiple producers and a single consumer.
+    /// Every item carries a sequence index and goes into its own slot (index % capacity), 
+    /// so items can be produced in any order, but are consumed strictly in index order.
+    /// Producers block while their index is beyond the window (real backpressure, no polling).
+    /// The consumer does not take any lock as long as the next item is already available.
+    /// T must be default-constructible and movable.
+    template<typename T>
+    class ReorderBuffer
+    {
+        struct Slot
+        {
+            T Item;
+            std::atomic<bool> IsFull;
+
+            Slot() : IsFull(false) {}
+        };
+
+        std::unique_ptr<Slot[]> slots;
+        uint32 capacity;
+
+        /// Index of the next item to be consumed. Only written by the consumer.
+        std::atomic<uint32> iNext;
+        std::atomic<int> nBuffered;
+        std::atomic<int> nWaitingProducers;
+        std::atomic<bool> isConsumerWaiting;
+        std::atomic<bool> isClosed;
+
+        std::mutex windowLock;
+        std::condition_variable producerCondition;
+        std::condition_variable consumerCondition;
+
+        /// Disallow copy ctor
+        ReorderBuffer(const ReorderBuffer&);
+        ReorderBuffer& operator=(const ReorderBuffer&);
+
+        bool IsInWindow(uint32 index) const { return index < iNext.load() + capacity; }
+
+    public:
+        /// Called for every item that is dropped without being consumed
+        typedef std::function<void(T&)> ReleaseCallback;
+
+        ReorderBuffer(int capacity) :
+            slots(new Slot[capacity > 0 ? capacity : 1]),
+            capacity(capacity > 0 ? capacity : 1),
+            iNext(0),
+            nBuffered(0),
+            nWaitingProducers(0),
+            isConsumerWaiting(false),
+            isClosed(false)
+        {
+        }
+
+        /// Amount of items that have been produced, but not consumed yet.
+        int GetSize() const { return nBuffered.load(); }
+
+        /// Max amount of items that can be buffered.
+        int GetCapacity() const { return static_cast<int>(capacity); }
+
+        /// Index of the next item to be consumed.
+        uint32 GetNextIndex() const { return iNext.load(); }
+
+        /// Whether Close() has been called since the last Reset().
+        bool IsClosed() const { return isClosed.load(); }
+
+        /// Empties the window, re-opens it and lets it start at the given index.
+        /// Optionally changes the capacity.
+        /// If given, release is called for every item that has not been consumed, before it is dropped.
+        /// Make sure that producers and consumer are not running anymore before taking this step.
+        void Reset(uint32 firstIndex, int newCapacity = 0, const ReleaseCallback& release = ReleaseCallback())
+        {
+            std::unique_lock<std::mutex> lk(windowLock);
+            for (uint32 i = 0; i < capacity; ++i)
+            {
+                if (release && slots[i].IsFull.load())
+                {
+                    release(slots[i].Item);
+                }
+                slots[i].Item = T();
+                slots[i].IsFull = false;
+            }
+            if (newCapacity > 0 && static_cast<uint32>(newCapacity) != capacity)
+            {
+                slots.reset(new Slot[newCapacity]);
+                capacity = newCapacity;
+            }
+            iNext = firstIndex;
+            nBuffered = 0;
+            isClosed = false;
+        }
+
+        /// Wakes up and releases all waiting producers and the consumer.
+        /// Push() and WaitForSlot() return false until the next Reset().
+        void Close()
+        {
+            {
+                std::unique_lock<std::mutex> lk(windowLock);
+                isClosed = true;
+            }
+            producerCondition.notify_all();
+            consumerCondition.notify_all();
+        }
+
+        /// Waits until the given index fits into the window.
+        /// Returns false, if the window has been closed in the meantime.
+        bool WaitForSlot(uint32 index)
+        {
+            if (!IsInWindow(index))
+            {
+                std::unique_lock<std::mutex> lk(windowLock);
+                ++nWaitingProducers;
+                producerCondition.wait(lk, [this, index]() { return isClosed.load() || IsInWindow(index); });
+                --nWaitingProducers;
+            }
+            return !isClosed.load();
+        }
+
+        /// Moves the given item into the slot of the given index (produce). 
+        /// Waits, while the index is beyond the window.
+        /// Returns false, if the window has been closed in the meantime. The item is left untouched in that case,
+        /// so the caller can release it.
+        bool Push(uint32 index, T&& item)
+        {
+            if (!WaitForSlot(index)) return false;
+
+            Slot& slot = slots[index % capacity];
+            assert(!slot.IsFull.load());
+
+            slot.Item = std::move(item);
+            ++nBuffered;
+            slot.IsFull = true;
+
+            if (isConsumerWaiting.load())
+            {
+                // lock, so the notification cannot get lost between the consumer's check and wait
+                std::unique_lock<std::mutex> lk(windowLock);
+                consumerCondition.notify_one();
+            }
+            return true;
+        }
+
+        /// Gets and removes the item with the next index (consume). Waits, while it is not available.
+        /// Must only be called by one thread at a time.
+        /// Returns a default-constructed item, if the window has been closed in the meantime.
+        T Pop()
+        {
+            Slot& slot = slots[iNext.load() % capacity];
+            if (!slot.IsFull.load())
+            {
+                // slow path: wait for the producer of the next item
+                std::unique_lock<std::mutex> lk(windowLock);
+                isConsumerWaiting = true;
+                consumerCondition.wait(lk, [this, &slot]() { return slot.IsFull.load() || isClosed.load(); });
+                isConsumerWaiting = false;
+
+                if (!slot.IsFull.load()) return T();
+            }
+
+            T item(std::move(slot.Item));
+            slot.Item = T();            // drop anything the moved-from item still references
+            slot.IsFull = false;
+            --nBuffered;
+            iNext = iNext.load() + 1;
+
+            if (nWaitingProducers.load() > 0)
+            {
+                // lock, so the notification cannot get lost between a producer's check and wait
+                std::unique_lock<std::mutex> lk(windowLock);
+                producerCondition.notify_all();
             }
+            return item;
         }
     };
 }
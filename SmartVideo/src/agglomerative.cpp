@@ -1,75 +1,202 @@
 #include "agglomerative.h"
+#include "Workers.h"
+
+#include <algorithm>
+#include <cmath>
 
 namespace Agglomerative {
 
-    // DisjointSet {{{
-    class DisjointSet {
-    public:
-        int n;
-        int *rep,*rank,*sz;
-        DisjointSet(int _n):n(_n) {
-            rep = new int[n];
-            rank = new int[n];
-            sz = new int[n];
-            for(int i=0;i<n;i++) {
-                rep[i] = i;
-                sz[i] = 1;
+    double dist2(Point2D a,Point2D b) {
+        return (a.x-b.x)*(a.x-b.x)+(a.y-b.y)*(a.y-b.y);
+    }
+
+    vector<Result> AgglomerativeClustering::clusterBruteForce(double dthreshold, int cthreshold) {
+        DisjointSet<int> djs(n);
+        double thr2 = dthreshold * dthreshold;
+        for(int i=0; i<n; i++) {
+            for(int j=0; j<n; j++) {
+                if(dist2(pts[i],pts[j])<thr2) {
+                    djs.merge(i,j);
+                }
             }
         }
-        ~DisjointSet() {
-            delete [] rep;
-            delete [] rank;
-            delete [] sz;
-        }
-        int getrep(int v) {
-            if(rep[v]!=v) rep[v] = getrep(rep[v]);
-            return rep[v];
+        return labelComponents(pts, [&djs](int i) { return djs.getrep(i); }, n, cthreshold);
+    }
+
+    /// Points bucketed into a uniform grid (counting sort). 
+    /// Cells are small enough that all points of one cell are closer than dthreshold,
+    /// so only points of different cells (at most Reach cells apart) have to be compared.
+    /// Grid rows follow the points' x (image rows).
+    struct PointGrid {
+        static const int Reach = 2;
+
+        double thr2;
+        int rows, cols;
+        vector<int> cellOf;         // cell of every point
+        vector<int> cellStart;      // first point of every cell (plus end)
+        vector<Point2D> cellPts;    // points, sorted by cell
+
+        PointGrid(const vector<Point2D>& pts, double dthreshold) {
+            int n = pts.size();
+            thr2 = dthreshold * dthreshold;
+            double cellSize = dthreshold / sqrt(2.0);
+
+            int minx = pts[0].x, maxx = pts[0].x, miny = pts[0].y, maxy = pts[0].y;
+            for(int i=1; i<n; i++) {
+                minx = min(minx, pts[i].x); maxx = max(maxx, pts[i].x);
+                miny = min(miny, pts[i].y); maxy = max(maxy, pts[i].y);
+            }
+            rows = static_cast<int>((maxx - minx) / cellSize) + 1;
+            cols = static_cast<int>((maxy - miny) / cellSize) + 1;
+            int nCells = rows * cols;
+
+            cellOf.resize(n);
+            cellStart.assign(nCells + 1, 0);
+            for(int i=0; i<n; i++) {
+                int r = static_cast<int>((pts[i].x - minx) / cellSize);
+                int c = static_cast<int>((pts[i].y - miny) / cellSize);
+                cellOf[i] = r * cols + c;
+                cellStart[cellOf[i] + 1]++;
+            }
+            for(int c=0; c<nCells; c++) cellStart[c+1] += cellStart[c];
+            cellPts.assign(n, Point2D(0,0));
+            vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+            for(int i=0; i<n; i++) cellPts[fill[cellOf[i]]++] = pts[i];
         }
-        int getsize(int v) {
-            return sz[getrep(v)];
+
+        int cellCount() const { return rows * cols; }
+        bool isEmpty(int c) const { return cellStart[c] == cellStart[c+1]; }
+
+        /// Whether any point of cell a is closer than dthreshold to any point of cell b.
+        bool isClose(int a, int b) const {
+            for(int i=cellStart[a]; i<cellStart[a+1]; i++) {
+                for(int j=cellStart[b]; j<cellStart[b+1]; j++) {
+                    if(dist2(cellPts[i],cellPts[j])<thr2) return true;
+                }
+            }
+            return false;
         }
-        bool merge(int v,int u) {
-            v = getrep(v);
-            u = getrep(u);
-            if(v==u) return 0;
-            if(rank[v] < rank[u]) {
-                rep[v] = u;
-                sz[u] += sz[v];
-            } else {
-                rep[u] = v;
-                sz[v] += sz[u];
-                if(rank[v] == rank[u]) rank[v]++;
+
+        /// Joins all cells in rows [rBegin, rEnd) with their close neighbours in rows [nBegin, nEnd).
+        /// Every neighbour pair is visited only once (from the upper, or else the left cell).
+        void joinCells(DisjointSet<int>& djs, int rBegin, int rEnd, int nBegin, int nEnd) const {
+            for(int r=rBegin; r<rEnd; r++) {
+                for(int c=0; c<cols; c++) {
+                    int a = r * cols + c;
+                    if(isEmpty(a)) continue;
+
+                    for(int dr=max(0, nBegin-r); dr<=Reach && r+dr<nEnd; dr++) {
+                        for(int dc=(dr==0 ? 1 : -Reach); dc<=Reach; dc++) {
+                            if(c+dc < 0 || c+dc >= cols) continue;
+                            int b = a + dr * cols + dc;
+                            if(isEmpty(b) || djs.getrep(a) == djs.getrep(b)) continue;
+                            if(isClose(a,b)) djs.merge(a,b);
+                        }
+                    }
+                }
             }
-            return 1;
+        }
+
+        /// Final set of every cell (read-only from here on).
+        vector<int> cellRoots(DisjointSet<int>& djs) const {
+            vector<int> roots(cellCount());
+            for(int c=0; c<cellCount(); c++) roots[c] = djs.getrep(c);
+            return roots;
         }
     };
-    // }}}
 
-    double dist2(Point2D a,Point2D b) {
-        return (a.x-b.x)*(a.x-b.x)+(a.y-b.y)*(a.y-b.y);
+    vector<Result> AgglomerativeClustering::cluster(double dthreshold, int cthreshold) {
+        if(n == 0) return vector<Result>();
+        if(dthreshold <= 0) {
+            // no two points are close enough
+            return labelComponents(pts, [](int i) { return i; }, n, cthreshold);
+        }
+
+        PointGrid grid(pts, dthreshold);
+
+        // join cells that have any pair of close points
+        DisjointSet<int> djs(grid.cellCount());
+        grid.joinCells(djs, 0, grid.rows, 0, grid.rows);
+
+        vector<int> roots = grid.cellRoots(djs);
+        return labelComponents(pts, [&roots, &grid](int i) { return roots[grid.cellOf[i]]; }, grid.cellCount(), cthreshold);
     }
 
-    vector<Result> AgglomerativeClustering::cluster(double dthreshold, int cthreshold) {
-        // TODO: faster version (i.e. planar MST / real agglomerative)
-        DisjointSet djs(n);
-        vector<int> idmap(n,-1);
-        int idc = 0;
-        double thr2 = dthreshold * dthreshold;
-        for(int i=0; i<n; i++) {
-            for(int j=0; j<n; j++) {
-                if(dist2(pts[i],pts[j])<thr2) {
-                    djs.merge(i,j);
+    vector<Result> AgglomerativeClustering::clusterApproximate(double dthreshold, int cthreshold, int maxPoints) {
+        if(n <= maxPoints || maxPoints <= 0 || dthreshold <= 0) return cluster(dthreshold, cthreshold);
+
+        int minx = pts[0].x, maxx = pts[0].x, miny = pts[0].y, maxy = pts[0].y;
+        for(int i=1; i<n; i++) {
+            minx = min(minx, pts[i].x); maxx = max(maxx, pts[i].x);
+            miny = min(miny, pts[i].y); maxy = max(maxy, pts[i].y);
+        }
+
+        // a cell of side s holds at most s*s points, so start with the smallest side that could fit, and double
+        int side = max(1, static_cast<int>(sqrt(static_cast<double>(n) / maxPoints)));
+        int rows, cols;
+        vector<int> cellOf(n);
+        vector<int> repOf;          // representative of every cell (index into reps), -1 if empty
+        vector<Point2D> reps;
+        for(;;) {
+            rows = (maxx - minx) / side + 1;
+            cols = (maxy - miny) / side + 1;
+            repOf.assign(rows * cols, -1);
+            reps.clear();
+            for(int i=0; i<n && static_cast<int>(reps.size()) <= maxPoints; i++) {
+                int c = (pts[i].x - minx) / side * cols + (pts[i].y - miny) / side;
+                cellOf[i] = c;
+                if(repOf[c] < 0) {
+                    repOf[c] = reps.size();
+                    reps.push_back(pts[i]);
                 }
             }
+            if(static_cast<int>(reps.size()) <= maxPoints) break;
+            side *= 2;
         }
-        vector<Result> results;
-        for(int i=0; i<n; i++) {
-            if(djs.getsize(i) < cthreshold) continue;
-            int h = djs.getrep(i);
-            if(idmap[h] < 0) idmap[h] = idc++;
-            results.push_back(Result(pts[i],idmap[h]));
+
+        // any point is within delta of its representative, so two close points have representatives
+        // closer than dthreshold + 2*delta
+        double delta = (side - 1) * sqrt(2.0);
+        AgglomerativeClustering repClustering(reps);
+        vector<Result> repResults = repClustering.cluster(dthreshold + 2 * delta, 1);
+        vector<int> repCluster(reps.size());
+        int nRepClusters = 0;
+        for(size_t r=0; r<repResults.size(); r++) {
+            repCluster[r] = repResults[r].id;
+            nRepClusters = max(nRepClusters, repResults[r].id + 1);
+        }
+
+        return labelComponents(pts, [&repCluster, &repOf, &cellOf](int i) { return repCluster[repOf[cellOf[i]]]; }, nRepClusters, cthreshold);
+    }
+
+    vector<Result> AgglomerativeClustering::clusterParallel(double dthreshold, int cthreshold, Util::WorkerPool& pool) {
+        if(n == 0 || dthreshold <= 0) return cluster(dthreshold, cthreshold);
+
+        PointGrid grid(pts, dthreshold);
+
+        // horizontal tiles, at least Reach cell rows (that is, dthreshold) each
+        int nTiles = min(2 * pool.GetWorkerCount(), grid.rows / PointGrid::Reach);
+        if(nTiles <= 1) return cluster(dthreshold, cthreshold);
+        vector<int> tileStart(nTiles + 1);
+        for(int t=0; t<=nTiles; t++) tileStart[t] = static_cast<int>(static_cast<long long>(grid.rows) * t / nTiles);
+
+        // tiles only join cells within themselves, so they can share one set without locking
+        DisjointSet<int> djs(grid.cellCount());
+        pool.ParallelFor(0, nTiles, [&grid, &djs, &tileStart](Util::JobIndex first, Util::JobIndex last) {
+            for(Util::JobIndex t=first; t<last; t++) {
+                grid.joinCells(djs, tileStart[t], tileStart[t+1], tileStart[t], tileStart[t+1]);
+            }
+        }, 1);
+
+        // join across tile borders
+        for(int t=1; t<nTiles; t++) {
+            int border = tileStart[t];
+            grid.joinCells(djs, max(border - PointGrid::Reach, tileStart[t-1]), border, border, grid.rows);
         }
-        return results;
+
+        // same partition as the serial path, so labels come out bit-identical
+        vector<int> roots = grid.cellRoots(djs);
+        return labelComponents(pts, [&roots, &grid](int i) { return roots[grid.cellOf[i]]; }, grid.cellCount(), cthreshold);
     }
 
-}
\ No newline at end of file
+}
@@ -6,6 +6,11 @@
 
 using namespace std;
 
+namespace Util
+{
+    class WorkerPool;
+}
+
 namespace Agglomerative
 {
     typedef pair<double,double> Point;
@@ -21,19 +26,99 @@ namespace Agglomerative
         Result(Point2D pt,int id):pt(pt),id(id) {}
     };
 
+    // DisjointSet {{{
+    /// Flat disjoint set (union by size, path halving).
+    template<typename IndexT>
+    class DisjointSet {
+        vector<IndexT> rep;
+        vector<IndexT> sz;
+    public:
+        DisjointSet(IndexT n = 0) {
+            reset(n);
+        }
+        /// Puts every element into its own set.
+        void reset(IndexT n) {
+            rep.resize(n);
+            sz.assign(n, 1);
+            for(IndexT i=0;i<n;i++) rep[i] = i;
+        }
+        IndexT size() const { return static_cast<IndexT>(rep.size()); }
+        IndexT getrep(IndexT v) {
+            while(rep[v]!=v) {
+                rep[v] = rep[rep[v]];
+                v = rep[v];
+            }
+            return v;
+        }
+        IndexT getsize(IndexT v) {
+            return sz[getrep(v)];
+        }
+        bool merge(IndexT v,IndexT u) {
+            v = getrep(v);
+            u = getrep(u);
+            if(v==u) return false;
+            if(sz[v] < sz[u]) swap(u,v);
+            rep[u] = v;
+            sz[v] += sz[u];
+            return true;
+        }
+    };
+    // }}}
+
+    /// Assigns cluster ids to all points whose component has at least cthreshold points.
+    /// rootOf(i) gives the component of point i, in [0, nRoots).
+    /// Ids are assigned in order of first appearance, and results are in point order.
+    template<typename RootFn>
+    vector<Result> labelComponents(const vector<Point2D>& pts, RootFn rootOf, int nRoots, int cthreshold) {
+        int n = pts.size();
+        vector<int> roots(n);
+        vector<int> compSize(nRoots,0);
+        for(int i=0; i<n; i++) {
+            roots[i] = rootOf(i);
+            compSize[roots[i]]++;
+        }
+        vector<int> idmap(nRoots,-1);
+        int idc = 0;
+        vector<Result> results;
+        for(int i=0; i<n; i++) {
+            int h = roots[i];
+            if(compSize[h] < cthreshold) continue;
+            if(idmap[h] < 0) idmap[h] = idc++;
+            results.push_back(Result(pts[i],idmap[h]));
+        }
+        return results;
+    }
+
     class AgglomerativeClustering
     {
         int n;
-        vector<Point2D> pts;
+        const vector<Point2D>& pts;
 
     public:
+        /// Note: pts must outlive this object.
         AgglomerativeClustering(const vector<Point2D> &pts):pts(pts) {
             n = pts.size();
         }
         vector<Result> cluster(double dthreshold, int cthreshold);
         // break cluster with L2-distance $dthreshold$, and clean up noise with cluster size below $cthreshold$
+        // points are bucketed into a grid, so only points of nearby cells are compared
+
+        vector<Result> clusterParallel(double dthreshold, int cthreshold, Util::WorkerPool& pool);
+        // same result as cluster(), joining horizontal tiles of the grid in parallel, and then across tile borders
+
+        vector<Result> clusterApproximate(double dthreshold, int cthreshold, int maxPoints);
+        // bounded-cost variant of cluster() for crowded frames: points are snapped to square cells of side s,
+        // only one representative point per non-empty cell (at most $maxPoints$) is clustered,
+        // with the threshold widened to dthreshold + 2*delta (delta = (s-1)*sqrt(2), the largest distance to a representative),
+        // and every point then takes the cluster of its representative, so areas and bounding boxes still cover all points.
+        // Error bound: points closer than dthreshold always share a cluster, so no exact cluster is ever split,
+        // and before noise removal there are never more clusters than cluster() finds. Clusters may merge across gaps
+        // below dthreshold + 2*delta. Noise removal uses the true point count of each cluster.
+
+        vector<Result> clusterBruteForce(double dthreshold, int cthreshold);
+        // same result as cluster(), comparing all pairs of points in O(n^2) (for reference)
     };
 
 }
 
-#endif // AGGLOMERATIVE_H
\ No newline at end of file
+#endif // AGGLOMERATIVE_H
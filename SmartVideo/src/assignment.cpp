@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <climits>
+#include <functional>
+#include <queue>
+
+#include "assignment.h"
+
+using namespace std;
+
+namespace Assignment {
+
+    void SparseAssignment::reset(int xn,int yn) {
+        this->xn=xn;
+        this->yn=yn;
+        xPenalty.assign(xn,0);
+        yPenalty.assign(yn,0);
+        edges.clear();
+    }
+
+    void SparseAssignment::buildGraph() {
+        edgeStart.assign(xn+1,0);
+        for(size_t i=0;i<edges.size();i++) edgeStart[edges[i].x+1]++;
+        for(int x=0;x<xn;x++) edgeStart[x+1]+=edgeStart[x];
+
+        vector<int>& fill=prevEdge;    // not needed until augment()
+        fill.assign(edgeStart.begin(),edgeStart.end()-1);
+        edgeX.resize(edges.size());
+        edgeY.resize(edges.size());
+        edgeWeight.resize(edges.size());
+        for(size_t i=0;i<edges.size();i++) {
+            const Edge& e=edges[i];
+            int k=fill[e.x]++;
+            edgeX[k]=e.x;
+            edgeY[k]=e.y;
+            edgeWeight[k]=static_cast<long long>(e.cost)-xPenalty[e.x]-yPenalty[e.y];
+        }
+    }
+
+    bool SparseAssignment::augment() {
+        const long long unreached=LLONG_MAX;
+        int nNodes=xn+yn;
+        dist.assign(nNodes+1,unreached);
+        done.assign(nNodes+1,0);
+        prevEdge.assign(yn,nil);
+
+        // free x are the sources, free y lead to the sink (node nNodes), which gets the lowest potential of them
+        long long sinkPotential=unreached;
+        for(int y=0;y<yn;y++) if(yx[y]==nil) sinkPotential=min(sinkPotential,potential[xn+y]);
+        if(sinkPotential==unreached) return false;
+
+        typedef pair<long long,int> Label;
+        priority_queue<Label,vector<Label>,greater<Label>> queue;
+        for(int x=0;x<xn;x++) {
+            if(xy[x]!=nil) continue;
+            dist[x]=-potential[x];
+            queue.push(Label(dist[x],x));
+        }
+
+        // Dijkstra on reduced weights (weight + potential(from) - potential(to) >= 0)
+        while(!queue.empty()) {
+            Label top=queue.top();
+            queue.pop();
+            int u=top.second;
+            if(done[u]) continue;
+            done[u]=1;
+            if(u==nNodes) break;
+
+            if(u<xn) {
+                for(int e=edgeStart[u];e<edgeStart[u+1];e++) {
+                    int y=edgeY[e];
+                    if(xy[u]==y) continue;
+                    long long d=dist[u]+edgeWeight[e]+potential[u]-potential[xn+y];
+                    if(d<dist[xn+y]) {
+                        dist[xn+y]=d;
+                        prevEdge[y]=e;
+                        queue.push(Label(d,xn+y));
+                    }
+                }
+            } else {
+                int y=u-xn;
+                if(yx[y]==nil) {
+                    long long d=dist[u]+potential[u]-sinkPotential;
+                    if(d<dist[nNodes]) {
+                        dist[nNodes]=d;
+                        sinkPrev=y;
+                        queue.push(Label(d,nNodes));
+                    }
+                } else {
+                    // back along the assigned pair
+                    int x=yx[y];
+                    long long d=dist[u]-edgeWeight[matchedEdge[y]]+potential[u]-potential[x];
+                    if(d<dist[x]) {
+                        dist[x]=d;
+                        queue.push(Label(d,x));
+                    }
+                }
+            }
+        }
+
+        // the path is only worth taking if it lowers the total cost
+        if(!done[nNodes] || dist[nNodes]+sinkPotential>=0) return false;
+
+        // keep reduced weights non-negative (and zero along the path)
+        long long dsink=dist[nNodes];
+        for(int v=0;v<nNodes;v++) potential[v]+=min(dist[v],dsink);
+
+        for(int y=sinkPrev;;) {
+            int e=prevEdge[y];
+            int x=edgeX[e];
+            int next=xy[x];
+            xy[x]=y;
+            yx[y]=x;
+            matchedEdge[y]=e;
+            if(next==nil) break;
+            y=next;
+        }
+        return true;
+    }
+
+    long long SparseAssignment::minimumAssignment() {
+        buildGraph();
+        xy.assign(xn,nil);
+        yx.assign(yn,nil);
+        matchedEdge.assign(yn,nil);
+
+        // initial potentials: no pairs are assigned, so only x -> y edges exist
+        potential.assign(xn+yn,0);
+        for(size_t e=0;e<edgeY.size();e++) {
+            long long& p=potential[xn+edgeY[e]];
+            p=min(p,edgeWeight[e]);
+        }
+
+        while(augment());
+
+        long long c=0;
+        for(int x=0;x<xn;x++) c+=xPenalty[x];
+        for(int y=0;y<yn;y++) {
+            c+=yPenalty[y];
+            if(yx[y]!=nil) c+=edgeWeight[matchedEdge[y]];
+        }
+        return c;
+    }
+
+}
@@ -0,0 +1,72 @@
+#ifndef ASSIGNMENT_H
+#define ASSIGNMENT_H
+
+#include <vector>
+
+namespace Assignment {
+
+    const int nil = -1;
+
+    /// Minimum cost assignment on a sparse bipartite graph, where nodes may stay unassigned.
+    /// Every x and every y pays its penalty if it is not assigned, and every assigned pair pays its edge cost.
+    /// Only pairs added by addEdge() can be assigned.
+    ///
+    /// Solved by successive shortest augmenting paths (Dijkstra with potentials, as in the augmentation phase
+    /// of LAPJV): every path adds one assignment, and paths only get more expensive, so solving stops as soon as
+    /// no path lowers the total cost. Takes O(k * E log V) for k assignments and E edges, independent of how many
+    /// pairs are left out.
+    /// Buffers keep their capacity, so one instance can solve many problems without reallocating.
+    class SparseAssignment {
+
+        struct Edge {
+            int x,y,cost;
+            Edge(int x,int y,int cost):x(x),y(y),cost(cost) {}
+        };
+
+        int xn,yn;
+        std::vector<int> xPenalty,yPenalty;
+        std::vector<Edge> edges;
+
+        // adjacency of x (CSR), built by minimumAssignment()
+        std::vector<int> edgeStart;
+        std::vector<int> edgeX,edgeY;
+        std::vector<long long> edgeWeight;     // cost minus both penalties (negative, if assigning the pair pays off)
+        std::vector<int> matchedEdge;          // edge that y is assigned by, or nil
+
+        std::vector<int> xy,yx;
+        std::vector<long long> potential;      // x in [0, xn), y in [xn, xn+yn)
+        std::vector<long long> dist;
+        std::vector<int> prevEdge;             // edge that reached y on the shortest path
+        std::vector<char> done;
+        int sinkPrev;                          // free y that ends the shortest path
+
+        void buildGraph();
+        bool augment();
+
+        /// Disallow copy ctor
+        SparseAssignment(const SparseAssignment&);
+        SparseAssignment& operator=(const SparseAssignment&);
+
+    public:
+        SparseAssignment(int xn = 0,int yn = 0) {
+            reset(xn,yn);
+        }
+
+        /// Starts a new problem of the given size, without edges, and with all penalties 0.
+        void reset(int xn,int yn);
+
+        void setXPenalty(int x,int c) { xPenalty[x]=c; }
+        void setYPenalty(int y,int c) { yPenalty[y]=c; }
+        void addEdge(int x,int y,int c) { edges.push_back(Edge(x,y,c)); }
+
+        int getEdgeCount() const { return edges.size(); }
+        int getMatchX(int x) const { return xy[x]; }
+        int getMatchY(int y) const { return yx[y]; }
+
+        /// Returns the minimum total cost.
+        long long minimumAssignment();
+    };
+
+}
+
+#endif // ASSIGNMENT_H
@@ -0,0 +1,259 @@
+#include "backgroundModel.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BACKGROUND_MODEL_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace cv;
+using namespace std;
+
+namespace SmartVideo
+{
+    namespace
+    {
+        const int BlockSize = GaussianBackgroundModel::BlockSize;
+        /// Amount of frames that the automatic learning rate averages over (like cv::BackgroundSubtractorMOG)
+        const int AutoHistory = 200;
+        const int MaxVariance = 32767;
+        const size_t Alignment = 16;
+
+        template<typename T>
+        T* AlignedData(std::vector<T>& buffer, size_t n)
+        {
+            buffer.assign(n + Alignment / sizeof(T), 0);
+            size_t address = reinterpret_cast<size_t>(buffer.data());
+            return reinterpret_cast<T*>((address + Alignment - 1) & ~(Alignment - 1));
+        }
+
+        /// round(v * a / 2^16)
+        inline int MulRound(int v, int a)
+        {
+            int p = v * a;
+            return (p >> 16) + ((p >> 15) & 1);
+        }
+
+        /// Interleaved channels -> one run of BlockSize values per channel (pixels past the end of the row stay 0)
+        template<int NChannels>
+        void Deinterleave(const unsigned char* src, unsigned char* row, int width)
+        {
+            int nFull = width / BlockSize;
+            for (int b = 0; b < nFull; ++b, src += BlockSize * NChannels, row += BlockSize * NChannels)
+            {
+                for (int i = 0; i < BlockSize; ++i)
+                {
+                    for (int c = 0; c < NChannels; ++c) row[c * BlockSize + i] = src[i * NChannels + c];
+                }
+            }
+            for (int i = 0; i < width - nFull * BlockSize; ++i)
+            {
+                for (int c = 0; c < NChannels; ++c) row[c * BlockSize + i] = src[i * NChannels + c];
+            }
+        }
+
+#ifdef BACKGROUND_MODEL_SSE2
+        inline __m128i MulRound(__m128i v, __m128i a)
+        {
+            __m128i hi = _mm_mulhi_epi16(v, a);
+            __m128i lo = _mm_mullo_epi16(v, a);
+            return _mm_add_epi16(hi, _mm_srli_epi16(lo, 15));
+        }
+
+        /// Deinterleave<3> for 32 pixels at a time: five rounds of interleaving the bytes of vectors (0, 3), (1, 4) and (2, 5)
+        /// turn 6 vectors of interleaved channels into 2 vectors per channel
+        void DeinterleaveBgr(const unsigned char* src, unsigned char* row, int width)
+        {
+            const int ChunkSize = 32;
+            int nChunks = width / ChunkSize;
+            for (int k = 0; k < nChunks; ++k, src += ChunkSize * 3, row += ChunkSize * 3)
+            {
+                __m128i v[6], t[6];
+                for (int i = 0; i < 6; ++i) v[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16 * i));
+                for (int round = 0; round < 5; ++round)
+                {
+                    for (int i = 0; i < 3; ++i)
+                    {
+                        t[2 * i] = _mm_unpacklo_epi8(v[i], v[i + 3]);
+                        t[2 * i + 1] = _mm_unpackhi_epi8(v[i], v[i + 3]);
+                    }
+                    for (int i = 0; i < 6; ++i) v[i] = t[i];
+                }
+
+                // v[2c + h] holds pixels [16h, 16h + 16) of channel c, which are blocks 2h and 2h + 1
+                for (int c = 0; c < 3; ++c)
+                {
+                    for (int h = 0; h < 2; ++h)
+                    {
+                        __m128i values = v[2 * c + h];
+                        _mm_storel_epi64(reinterpret_cast<__m128i*>(row + (2 * h) * 3 * BlockSize + c * BlockSize), values);
+                        _mm_storel_epi64(reinterpret_cast<__m128i*>(row + (2 * h + 1) * 3 * BlockSize + c * BlockSize), _mm_unpackhi_epi64(values, values));
+                    }
+                }
+            }
+            Deinterleave<3>(src, row, width - nChunks * ChunkSize);
+        }
+#endif
+
+        /// Matches one row of blocks against the model, and updates the model.
+        /// Fixed point: means are 8.7 (pixel << 7), distances 8.4 (their squares 8.8), variances x.4
+        template<int NChannels>
+        void UpdateRow(const unsigned char* x, unsigned short* m, unsigned char* fg, int nBlocks, int a, int k2, int minVariance)
+        {
+#ifdef BACKGROUND_MODEL_SSE2
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i va = _mm_set1_epi16(static_cast<short>(a));
+            const __m128i vk2 = _mm_set1_epi32(k2);
+            const __m128i vMinVariance = _mm_set1_epi16(static_cast<short>(minVariance));
+#endif
+
+            for (int b = 0; b < nBlocks; ++b, m += (NChannels + 1) * BlockSize, x += NChannels * BlockSize, fg += BlockSize)
+            {
+#ifdef BACKGROUND_MODEL_SSE2
+                __m128i dist2Lo = zero, dist2Hi = zero;
+                for (int c = 0; c < NChannels; ++c)
+                {
+                    __m128i* pMean = reinterpret_cast<__m128i*>(m + c * BlockSize);
+                    __m128i mean = _mm_load_si128(pMean);
+                    __m128i xc = _mm_slli_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(x + c * BlockSize)), zero), 7);
+                    __m128i delta = _mm_sub_epi16(xc, mean);
+                    __m128i d = _mm_srai_epi16(delta, 3);
+                    __m128i dLo = _mm_unpacklo_epi16(d, zero), dHi = _mm_unpackhi_epi16(d, zero);
+                    dist2Lo = _mm_add_epi32(dist2Lo, _mm_madd_epi16(dLo, dLo));
+                    dist2Hi = _mm_add_epi32(dist2Hi, _mm_madd_epi16(dHi, dHi));
+                    _mm_store_si128(pMean, _mm_add_epi16(mean, MulRound(delta, va)));
+                }
+
+                __m128i* pVariance = reinterpret_cast<__m128i*>(m + NChannels * BlockSize);
+                __m128i variance = _mm_load_si128(pVariance);
+                __m128i limitLo = _mm_madd_epi16(_mm_unpacklo_epi16(variance, zero), vk2);
+                __m128i limitHi = _mm_madd_epi16(_mm_unpackhi_epi16(variance, zero), vk2);
+                __m128i isForeground = _mm_packs_epi32(_mm_cmpgt_epi32(dist2Lo, limitLo), _mm_cmpgt_epi32(dist2Hi, limitHi));
+
+                // only background pixels update the variance
+                __m128i target = _mm_packs_epi32(_mm_srai_epi32(dist2Lo, 4), _mm_srai_epi32(dist2Hi, 4));
+                __m128i step = _mm_andnot_si128(isForeground, MulRound(_mm_sub_epi16(target, variance), va));
+                _mm_store_si128(pVariance, _mm_max_epi16(_mm_add_epi16(variance, step), vMinVariance));
+
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(fg), _mm_packs_epi16(isForeground, isForeground));
+#else
+                int dist2[BlockSize] = { 0 };
+                for (int c = 0; c < NChannels; ++c)
+                {
+                    unsigned short* mean = m + c * BlockSize;
+                    for (int i = 0; i < BlockSize; ++i)
+                    {
+                        int delta = (x[c * BlockSize + i] << 7) - mean[i];
+                        int d = delta >> 3;
+                        dist2[i] += d * d;
+                        mean[i] = static_cast<unsigned short>(mean[i] + MulRound(delta, a));
+                    }
+                }
+
+                unsigned short* variance = m + NChannels * BlockSize;
+                for (int i = 0; i < BlockSize; ++i)
+                {
+                    bool isForeground = dist2[i] > variance[i] * k2;
+                    fg[i] = isForeground ? 255 : 0;
+                    if (!isForeground)
+                    {
+                        int target = min(dist2[i] >> 4, MaxVariance);
+                        variance[i] = static_cast<unsigned short>(max(variance[i] + MulRound(target - variance[i], a), minVariance));
+                    }
+                }
+#endif
+            }
+        }
+    }
+
+
+    void GaussianBackgroundModel::Init(const Mat& frame)
+    {
+        width = frame.cols;
+        height = frame.rows;
+        nChannels = frame.channels();
+        blocksPerRow = (width + BlockSize - 1) / BlockSize;
+
+        int blockValues = (nChannels + 1) * BlockSize;
+        model = AlignedData(modelBuffer, static_cast<size_t>(height) * blocksPerRow * blockValues);
+        row = AlignedData(rowBuffer, static_cast<size_t>(blocksPerRow) * nChannels * BlockSize);
+        maskRow.assign(blocksPerRow * BlockSize, 0);
+
+        // the first frame is the mean, with the same variance everywhere
+        int initialVariance = min(static_cast<int>(initialSigma * initialSigma * nChannels * 16 + 0.5), MaxVariance);
+        for (int y = 0; y < height; ++y)
+        {
+            LoadRow(frame.ptr<unsigned char>(y));
+            unsigned short* m = model + static_cast<size_t>(y) * blocksPerRow * blockValues;
+            for (int b = 0; b < blocksPerRow; ++b, m += blockValues)
+            {
+                const unsigned char* x = row + b * nChannels * BlockSize;
+                for (int i = 0; i < nChannels * BlockSize; ++i) m[i] = static_cast<unsigned short>(x[i] << 7);
+                for (int i = 0; i < BlockSize; ++i) m[nChannels * BlockSize + i] = static_cast<unsigned short>(initialVariance);
+            }
+        }
+    }
+
+    void GaussianBackgroundModel::LoadRow(const unsigned char* src)
+    {
+        switch (nChannels)
+        {
+        case 1: memcpy(row, src, width); break;
+        case 2: Deinterleave<2>(src, row, width); break;
+#ifdef BACKGROUND_MODEL_SSE2
+        case 3: DeinterleaveBgr(src, row, width); break;
+#else
+        case 3: Deinterleave<3>(src, row, width); break;
+#endif
+        default: Deinterleave<4>(src, row, width); break;
+        }
+    }
+
+    void GaussianBackgroundModel::Apply(const Mat& frame, Mat& foregroundMask, double learningRate)
+    {
+        CV_Assert(frame.depth() == CV_8U && frame.channels() <= MaxChannels);
+
+        foregroundMask.create(frame.size(), CV_8U);
+        if (nFrames == 0 || frame.cols != width || frame.rows != height || frame.channels() != nChannels)
+        {
+            Init(frame);
+            nFrames = 1;
+            foregroundMask = Scalar::all(0);
+            return;
+        }
+        ++nFrames;
+
+        double rate = learningRate >= 0 ? learningRate : 1. / min<long long>(nFrames, AutoHistory);
+        int a = min(static_cast<int>(min(rate, 0.5) * 65536 + 0.5), 32767);
+        int k2 = static_cast<int>(min(threshold * threshold * 16 + 0.5, 32767.));
+        int minVariance = min(static_cast<int>(minSigma * minSigma * nChannels * 16 + 0.5), MaxVariance);
+
+        int blockValues = (nChannels + 1) * BlockSize;
+        for (int y = 0; y < height; ++y)
+        {
+            LoadRow(frame.ptr<unsigned char>(y));
+            unsigned short* m = model + static_cast<size_t>(y) * blocksPerRow * blockValues;
+            unsigned char* fg = &maskRow[0];
+            switch (nChannels)
+            {
+            case 1: UpdateRow<1>(row, m, fg, blocksPerRow, a, k2, minVariance); break;
+            case 2: UpdateRow<2>(row, m, fg, blocksPerRow, a, k2, minVariance); break;
+            case 3: UpdateRow<3>(row, m, fg, blocksPerRow, a, k2, minVariance); break;
+            default: UpdateRow<4>(row, m, fg, blocksPerRow, a, k2, minVariance); break;
+            }
+            memcpy(foregroundMask.ptr<unsigned char>(y), fg, width);
+        }
+    }
+
+
+    std::unique_ptr<BackgroundModel> CreateBackgroundModel(const std::string& name, double threshold)
+    {
+        if (name == "gaussian")
+        {
+            return std::unique_ptr<BackgroundModel>(threshold > 0 ? new GaussianBackgroundModel(threshold) : new GaussianBackgroundModel());
+        }
+        return std::unique_ptr<BackgroundModel>(new MogBackgroundModel());
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef BACKGROUNDMODEL_H
+#define BACKGROUNDMODEL_H
+
+#include "opencv2/core/core.hpp"
+#include <opencv2/video/background_segm.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace SmartVideo
+{
+    /// Learns the background of a clip, one frame at a time, and separates the foreground from it.
+    class BackgroundModel
+    {
+    public:
+        virtual ~BackgroundModel() {}
+
+        /// Updates the model with the given frame (CV_8UC1 to CV_8UC4), and sets all foreground pixels of the given mask to 255,
+        /// and all others to 0 (like cv::BackgroundSubtractor). The mask is (re-)allocated only if its size or type do not match.
+        /// The learning rate is the weight of the new frame (0 = no update); if negative, it is chosen automatically.
+        virtual void Apply(const cv::Mat& frame, cv::Mat& foregroundMask, double learningRate) = 0;
+    };
+
+
+    /// OpenCV's mixture of Gaussians (cv::BackgroundSubtractorMOG) with default parameters.
+    class MogBackgroundModel : public BackgroundModel
+    {
+        cv::BackgroundSubtractorMOG mog;
+
+    public:
+        virtual void Apply(const cv::Mat& frame, cv::Mat& foregroundMask, double learningRate)
+        {
+            mog(frame, foregroundMask, learningRate);
+        }
+    };
+
+
+    /// One running Gaussian per pixel, in 16-bit fixed point, vectorized with SSE2 (if available).
+    ///
+    /// Every pixel has a mean per channel and one variance, which is the sum of the variances of all channels.
+    /// A pixel is foreground, if its squared distance from the mean (summed over all channels) is more than
+    /// Threshold^2 times the variance. Means learn from all pixels, so objects that stop become background after a while,
+    /// but variances only learn from background pixels. The first frame is all background.
+    ///
+    /// The model is stored in blocks of BlockSize pixels of the same row, with all means of one channel and then all variances
+    /// next to each other, so every block is a few aligned vector loads. Frames are converted into the same layout one row at a time.
+    class GaussianBackgroundModel : public BackgroundModel
+    {
+    public:
+        static const int BlockSize = 8;
+        static const int MaxChannels = 4;
+
+    private:
+        double threshold;
+        double initialSigma, minSigma;
+
+        int width, height, nChannels;
+        int blocksPerRow;
+        long long nFrames;
+
+        /// Means (8.7 fixed point) and variances (4 fractional bits) of all blocks, (nChannels + 1) * BlockSize values per block
+        unsigned short* model;
+        std::vector<unsigned short> modelBuffer;
+        /// The current row of the frame, in block layout (nChannels * BlockSize values per block)
+        unsigned char* row;
+        std::vector<unsigned char> rowBuffer;
+        std::vector<unsigned char> maskRow;
+
+        /// Disallow copy ctor
+        GaussianBackgroundModel(const GaussianBackgroundModel&);
+        GaussianBackgroundModel& operator=(const GaussianBackgroundModel&);
+
+        void Init(const cv::Mat& frame);
+        void LoadRow(const unsigned char* src);
+
+    public:
+        /// Threshold is in standard deviations. Sigmas are in intensity levels (per channel).
+        GaussianBackgroundModel(double threshold = 2.5, double initialSigma = 15, double minSigma = 3) :
+            threshold(threshold),
+            initialSigma(initialSigma),
+            minSigma(minSigma),
+            width(0), height(0), nChannels(0),
+            blocksPerRow(0),
+            nFrames(0),
+            model(nullptr),
+            row(nullptr)
+        {
+        }
+
+        virtual void Apply(const cv::Mat& frame, cv::Mat& foregroundMask, double learningRate);
+
+        /// Forget everything learned. The next frame is all background.
+        void Clear() { nFrames = 0; }
+    };
+
+
+    /// Creates the background model of the given name: "mog" (default, see MogBackgroundModel),
+    /// or "gaussian" (see GaussianBackgroundModel, which uses the given threshold, if > 0).
+    std::unique_ptr<BackgroundModel> CreateBackgroundModel(const std::string& name, double threshold);
+}
+
+#endif // BACKGROUNDMODEL_H
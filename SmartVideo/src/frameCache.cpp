@@ -0,0 +1,122 @@
+#include "frameCache.h"
+
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+using namespace std;
+
+namespace SmartVideo
+{
+    bool FrameCache::Open(const std::string& fname, unsigned int firstFrame, unsigned int frameCount)
+    {
+        Close();
+
+        if (!file.OpenRead(fname) || file.GetSize() < sizeof(FrameCacheHeader))
+        {
+            file.Close();
+            return false;
+        }
+
+        const FrameCacheHeader* h = reinterpret_cast<const FrameCacheHeader*>(file.GetData());
+        bool isUsable = 
+            memcmp(h->Magic, "SVFC", 4) == 0 &&
+            h->Version == Version &&
+            h->IsComplete &&
+            h->FirstFrame == firstFrame &&
+            h->FrameCount == frameCount &&
+            h->DataOffset + h->FrameCount * h->FrameStride <= file.GetSize();
+        if (!isUsable)
+        {
+            file.Close();
+            return false;
+        }
+
+        header = h;
+        isWriting = false;
+        return true;
+    }
+
+    bool FrameCache::Create(const std::string& fname, unsigned int firstFrame, unsigned int frameCount, int width, int height, int type)
+    {
+        Close();
+
+        unsigned long long frameStride = static_cast<unsigned long long>(width) * height * CV_ELEM_SIZE(type);
+        unsigned long long dataOffset = (sizeof(FrameCacheHeader) + DataAlignment - 1) / DataAlignment * DataAlignment;
+        unsigned long long fileSize = dataOffset + frameCount * frameStride;
+        if (fileSize > std::numeric_limits<size_t>::max())
+        {
+            // cannot be mapped by a 32-bit process
+            return false;
+        }
+        if (!file.Create(fname, static_cast<size_t>(fileSize)))
+        {
+            return false;
+        }
+
+        // header stays incomplete until Close() verified that every frame has been written
+        FrameCacheHeader* h = reinterpret_cast<FrameCacheHeader*>(file.GetData());
+        memcpy(h->Magic, "SVFC", 4);
+        h->Version = Version;
+        h->Width = width;
+        h->Height = height;
+        h->Type = type;
+        h->FirstFrame = firstFrame;
+        h->FrameCount = frameCount;
+        h->IsComplete = 0;
+        h->FrameStride = frameStride;
+        h->DataOffset = dataOffset;
+
+        header = h;
+        isWriting = true;
+        nWrittenFrames = 0;
+        isValid = true;
+        return true;
+    }
+
+    void FrameCache::Close()
+    {
+        if (isWriting && header)
+        {
+            if (isValid && nWrittenFrames == header->FrameCount)
+            {
+                file.Flush();
+                const_cast<FrameCacheHeader*>(header)->IsComplete = 1;
+            }
+            else
+            {
+                cerr << "WARNING: Frame cache is incomplete and will be rebuilt next time." << endl;
+            }
+        }
+        file.Close();
+        header = nullptr;
+        isWriting = false;
+    }
+
+    cv::Mat FrameCache::GetFrame(unsigned int iFrame) const
+    {
+        assert(IsReadable() && iFrame - header->FirstFrame < header->FrameCount);
+        return cv::Mat(header->Height, header->Width, header->Type, GetFrameData(iFrame));
+    }
+
+    void FrameCache::PutFrame(unsigned int iFrame, const cv::Mat& frame)
+    {
+        assert(IsWriting());
+        if (iFrame - header->FirstFrame >= header->FrameCount ||
+            frame.cols != static_cast<int>(header->Width) || frame.rows != static_cast<int>(header->Height) ||
+            frame.type() != static_cast<int>(header->Type))
+        {
+            // frames of different formats cannot be cached
+            isValid = false;
+            return;
+        }
+
+        unsigned char* dst = GetFrameData(iFrame);
+        size_t rowSize = frame.cols * frame.elemSize();
+        for (int row = 0; row < frame.rows; ++row)
+        {
+            memcpy(dst + row * rowSize, frame.ptr(row), rowSize);
+        }
+        ++nWrittenFrames;
+    }
+}
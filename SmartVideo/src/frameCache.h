@@ -0,0 +1,89 @@
+#ifndef FRAMECACHE_H
+#define FRAMECACHE_H
+
+#include "FileUtil.h"
+
+#include "opencv2/core/core.hpp"
+
+#include <atomic>
+
+namespace SmartVideo
+{
+    /// Fixed-size header at the beginning of every frame cache file.
+    /// Frames follow at DataOffset, back to back, FrameStride bytes each.
+    struct FrameCacheHeader
+    {
+        char Magic[4];                  // "SVFC"
+        unsigned int Version;
+        unsigned int Width, Height;
+        unsigned int Type;              // OpenCV matrix type of all frames
+        unsigned int FirstFrame;        // index of the first cached frame
+        unsigned int FrameCount;        // amount of cached frames
+        unsigned int IsComplete;        // only set once every frame has been written
+        unsigned long long FrameStride; // bytes per frame
+        unsigned long long DataOffset;  // offset of the first frame (page-aligned)
+    };
+
+    /// Cache of decoded frames of one clip, stored uncompressed in a single file.
+    /// The first run over a clip fills the cache, later runs memory-map it and
+    /// hand out frames as views into the mapping, without decoding or opening any other file.
+    class FrameCache
+    {
+        static const unsigned int Version = 1;
+        static const size_t DataAlignment = 4096;
+
+        Util::MappedFile file;
+        const FrameCacheHeader* header;
+        bool isWriting;
+        std::atomic<unsigned int> nWrittenFrames;
+        std::atomic<bool> isValid;
+
+        /// Disallow copy ctor
+        FrameCache(const FrameCache&);
+        FrameCache& operator=(const FrameCache&);
+
+        unsigned char* GetFrameData(unsigned int iFrame) const
+        {
+            return const_cast<unsigned char*>(file.GetData()) + header->DataOffset + (iFrame - header->FirstFrame) * header->FrameStride;
+        }
+
+    public:
+        FrameCache() :
+            header(nullptr),
+            isWriting(false),
+            nWrittenFrames(0),
+            isValid(false)
+        {
+        }
+
+        virtual ~FrameCache()
+        {
+            Close();
+        }
+
+        /// Maps an existing cache that holds all frames in [firstFrame, firstFrame + frameCount).
+        /// Returns false, if there is no such cache, or if it is incomplete.
+        bool Open(const std::string& fname, unsigned int firstFrame, unsigned int frameCount);
+
+        /// Creates a new cache for frameCount frames of the given format, to be filled with PutFrame().
+        bool Create(const std::string& fname, unsigned int firstFrame, unsigned int frameCount, int width, int height, int type);
+
+        /// Marks the cache complete, if all frames have been written, and unmaps it.
+        void Close();
+
+        /// Whether frames can be read from this cache.
+        bool IsReadable() const { return header != nullptr && !isWriting; }
+
+        /// Whether this cache is waiting to be filled.
+        bool IsWriting() const { return isWriting; }
+
+        /// Get the given frame as a view into the mapping. The view must not be written to
+        /// and must not be used after Close().
+        cv::Mat GetFrame(unsigned int iFrame) const;
+
+        /// Copies the given frame into the cache. Can be called by multiple threads at once (for different frames).
+        void PutFrame(unsigned int iFrame, const cv::Mat& frame);
+    };
+}
+
+#endif // FRAMECACHE_H
@@ -0,0 +1,130 @@
+#include "framePool.h"
+
+#include <iostream>
+
+using namespace std;
+using namespace cv;
+
+namespace SmartVideo
+{
+    /// Keeps the Mats of one block on separate cache lines.
+    static size_t AlignSize(size_t size)
+    {
+        const size_t alignment = 64;
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    FrameBuffers FramePool::CreateBuffers(int iBlock)
+    {
+        unsigned char* data = static_cast<unsigned char*>(blocks[iBlock].Data);
+        size_t nPixels = static_cast<size_t>(width) * height;
+        size_t nAnalysisPixels = static_cast<size_t>(analysisWidth) * analysisHeight;
+
+        FrameBuffers buffers;
+        buffers.iBlock = iBlock;
+        buffers.Frame = Mat(height, width, CV_8UC3, data);
+        data += AlignSize(nPixels * 3);
+        if (analysisScale > 1)
+        {
+            buffers.AnalysisFrame = Mat(analysisHeight, analysisWidth, CV_8UC3, data);
+            data += AlignSize(nAnalysisPixels * 3);
+        }
+        buffers.ForegroundMask = Mat(analysisHeight, analysisWidth, CV_8U, data);
+        data += AlignSize(nAnalysisPixels);
+        buffers.ObjectMask = Mat(analysisHeight, analysisWidth, CV_32FC3, data);
+        return buffers;
+    }
+
+    void FramePool::Init(int nBuffers, int newWidth, int newHeight, int newAnalysisScale, bool newUseLargePages)
+    {
+        if (nBuffers == GetBufferCount() && newWidth == width && newHeight == height && newAnalysisScale == analysisScale && 
+            newUseLargePages == useLargePages)
+        {
+            return;
+        }
+        Clear();
+
+        width = newWidth;
+        height = newHeight;
+        analysisScale = newAnalysisScale;
+        Size analysisSize = GetAnalysisSize(width, height, analysisScale);
+        analysisWidth = analysisSize.width;
+        analysisHeight = analysisSize.height;
+        useLargePages = newUseLargePages;
+
+        // masks (and the downsampled frame) only need the analysis resolution
+        size_t nPixels = static_cast<size_t>(width) * height;
+        size_t nAnalysisPixels = static_cast<size_t>(analysisWidth) * analysisHeight;
+        size_t blockSize = AlignSize(nPixels * 3) + AlignSize(nAnalysisPixels) + nAnalysisPixels * 3 * sizeof(float);
+        if (analysisScale > 1)
+        {
+            blockSize += AlignSize(nAnalysisPixels * 3);
+        }
+
+        int nLargePageBlocks = 0;
+        for (int i = 0; i < nBuffers; ++i)
+        {
+            Block block;
+            bool isLarge;
+            block.Size = blockSize;
+            block.Data = Util::AllocPages(block.Size, useLargePages, &isLarge);
+            if (!block.Data)
+            {
+                cerr << "WARNING: Frame pool could only allocate " << i << " of " << nBuffers << " buffers." << endl;
+                break;
+            }
+            nLargePageBlocks += isLarge;
+            blocks.push_back(block);
+        }
+        if (useLargePages && nLargePageBlocks < GetBufferCount())
+        {
+            cerr << "WARNING: Only " << nLargePageBlocks << " of " << GetBufferCount() << " frame buffers use large pages." << endl;
+        }
+
+        std::unique_lock<std::mutex> lk(poolLock);
+        freeBuffers.reserve(blocks.size());
+        for (int i = 0; i < GetBufferCount(); ++i)
+        {
+            freeBuffers.push_back(CreateBuffers(i));
+        }
+    }
+
+    void FramePool::Clear()
+    {
+        std::unique_lock<std::mutex> lk(poolLock);
+        assert(freeBuffers.size() == blocks.size());
+
+        freeBuffers.clear();
+        for (auto& block : blocks)
+        {
+            Util::FreePages(block.Data, block.Size);
+        }
+        blocks.clear();
+    }
+
+    FrameBuffers FramePool::Acquire()
+    {
+        std::unique_lock<std::mutex> lk(poolLock);
+        if (blocks.empty())
+        {
+            return FrameBuffers();
+        }
+
+        bufferAvailable.wait(lk, [this]() { return !freeBuffers.empty(); });
+
+        FrameBuffers buffers(std::move(freeBuffers.back()));
+        freeBuffers.pop_back();
+        return buffers;
+    }
+
+    void FramePool::Release(FrameBuffers buffers)
+    {
+        if (!buffers.IsPooled()) return;
+
+        {
+            std::unique_lock<std::mutex> lk(poolLock);
+            freeBuffers.push_back(std::move(buffers));
+        }
+        bufferAvailable.notify_one();
+    }
+}
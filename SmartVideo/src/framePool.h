@@ -0,0 +1,152 @@
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include "ThreadUtil.h"
+#include "MemoryUtil.h"
+
+#include "opencv2/core/core.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace SmartVideo
+{
+    /// Pre-allocated memory for everything that is computed per frame.
+    /// The Mats point into pool memory, so OpenCV writes into them without allocating, 
+    /// as long as size and type match.
+    struct FrameBuffers
+    {
+        /// Decoded frame (CV_8UC3)
+        cv::Mat Frame;
+        /// Downsampled frame (CV_8UC3), if frames are analysed at a lower resolution
+        cv::Mat AnalysisFrame;
+        /// Binary foreground mask (CV_8U), at analysis resolution
+        cv::Mat ForegroundMask;
+        /// Object mask (CV_32FC3), at analysis resolution
+        cv::Mat ObjectMask;
+        /// Encoded image file, read from disk before decoding
+        std::vector<unsigned char> EncodedFrame;
+
+        /// Index of the pool block backing the Mats, or -1 if not pooled
+        int iBlock;
+
+        FrameBuffers() : iBlock(-1) {}
+
+        FrameBuffers(FrameBuffers&& other) :
+            Frame(other.Frame),
+            AnalysisFrame(other.AnalysisFrame),
+            ForegroundMask(other.ForegroundMask),
+            ObjectMask(other.ObjectMask),
+            EncodedFrame(std::move(other.EncodedFrame)),
+            iBlock(other.iBlock)
+        {
+            other.Reset();
+        }
+
+        FrameBuffers& operator=(FrameBuffers&& other)
+        {
+            if (this != &other)
+            {
+                Frame = other.Frame;
+                AnalysisFrame = other.AnalysisFrame;
+                ForegroundMask = other.ForegroundMask;
+                ObjectMask = other.ObjectMask;
+                EncodedFrame = std::move(other.EncodedFrame);
+                iBlock = other.iBlock;
+                other.Reset();
+            }
+            return *this;
+        }
+
+        bool IsPooled() const { return iBlock >= 0; }
+
+        void Reset()
+        {
+            Frame.release();
+            AnalysisFrame.release();
+            ForegroundMask.release();
+            ObjectMask.release();
+            EncodedFrame.clear();
+            iBlock = -1;
+        }
+
+    private:
+        /// Disallow copy ctor
+        FrameBuffers(const FrameBuffers&);
+        FrameBuffers& operator=(const FrameBuffers&);
+    };
+
+
+    /// A fixed set of FrameBuffers, recycled for all frames of a clip.
+    /// Every set lives in one block of pages, which optionally are large (huge) pages.
+    class FramePool
+    {
+        struct Block
+        {
+            void* Data;
+            size_t Size;
+        };
+
+        std::mutex poolLock;
+        std::condition_variable bufferAvailable;
+        std::vector<Block> blocks;
+        std::vector<FrameBuffers> freeBuffers;
+        int width, height;
+        int analysisScale;
+        int analysisWidth, analysisHeight;
+        bool useLargePages;
+
+        /// Disallow copy ctor
+        FramePool(const FramePool&);
+        FramePool& operator=(const FramePool&);
+
+        /// Create the Mat headers for the given block.
+        FrameBuffers CreateBuffers(int iBlock);
+
+    public:
+        FramePool() : 
+            width(0), 
+            height(0), 
+            analysisScale(1),
+            analysisWidth(0),
+            analysisHeight(0),
+            useLargePages(false)
+        {
+        }
+
+        virtual ~FramePool()
+        {
+            Clear();
+        }
+
+        /// Whether this pool has any buffers.
+        bool IsInitialized() const { return !blocks.empty(); }
+
+        /// Amount of buffers owned by this pool.
+        int GetBufferCount() const { return static_cast<int>(blocks.size()); }
+
+        /// Allocates nBuffers sets of buffers for frames of the given size, which are analysed at 1 / analysisScale of it
+        /// (see GetAnalysisSize). Keeps the current buffers, if they already match.
+        /// Make sure that no buffers are in use before calling this.
+        void Init(int nBuffers, int width, int height, int analysisScale, bool useLargePages);
+
+        /// Size of frames of the given size, at 1 / analysisScale of their resolution
+        static cv::Size GetAnalysisSize(int width, int height, int analysisScale)
+        {
+            return cv::Size(std::max(width / analysisScale, 1), std::max(height / analysisScale, 1));
+        }
+
+        /// Frees all buffers.
+        /// Make sure that no buffers are in use before calling this.
+        void Clear();
+
+        /// Gets a free set of buffers. Waits, while all buffers are in use.
+        /// Returns empty (non-pooled) buffers, if the pool has not been initialized.
+        FrameBuffers Acquire();
+
+        /// Returns the given buffers to the pool. Non-pooled buffers are just discarded.
+        void Release(FrameBuffers buffers);
+    };
+}
+
+#endif // FRAMEPOOL_H
@@ -0,0 +1,167 @@
+#include "frameWriter.h"
+#include "SmartVideo.h"
+#include "FileUtil.h"
+
+using namespace cv;
+using namespace std;
+using namespace Util;
+
+namespace SmartVideo
+{
+    FrameWriter::FrameWriter(FramePool& framePool) :
+        framePool(framePool),
+        queue(nullptr),
+        batchSize(1),
+        nBatchFrames(0),
+        isRunning(false),
+        writerPool(1)
+    {
+    }
+
+
+    void FrameWriter::Start(ThreadSafeQueue<FrameInfo>& queue, const string& foregroundFolder, 
+            const string& maskFolder, const string& imageType, int batchSize)
+    {
+        Finish();
+
+        this->queue = &queue;
+        this->foregroundFolder = foregroundFolder;
+        this->maskFolder = maskFolder;
+        this->imageType = imageType;
+        this->batchSize = max(batchSize, 1);
+
+        isRunning = true;
+        writerPool.Submit(std::bind(&FrameWriter::RunLoop, this));
+    }
+
+
+    void FrameWriter::StartArchive(ThreadSafeQueue<FrameInfo>& queue, const string& archivePath, 
+            unsigned int firstFrame, unsigned int frameCount, int batchSize)
+    {
+        Finish();
+
+        this->queue = &queue;
+        this->batchSize = max(batchSize, 1);
+        if (!archive.Create(archivePath, firstFrame, frameCount))
+        {
+            cerr << "Unable to create mask archive " << archivePath << endl;
+            cerr << "Press ENTER to exit." << endl; cin.get();
+            exit(EXIT_FAILURE);
+        }
+
+        isRunning = true;
+        writerPool.Submit(std::bind(&FrameWriter::RunArchiveLoop, this));
+    }
+
+
+    void FrameWriter::Finish()
+    {
+        if (!isRunning) return;
+
+        queue->Close();
+        writerPool.Join();
+        archive.Close();
+        isRunning = false;
+    }
+
+
+    int FrameWriter::GetQueueSize() const
+    {
+        return queue ? queue->GetSize() + nBatchFrames.load() : 0;
+    }
+
+
+    void FrameWriter::PrepareMasks(const FrameInfo& info, Mat& foreground, Mat& object)
+    {
+        info.FrameObjectDetection.convertTo(objectDumpBuffer, CV_8U, 255.0);
+        if (info.FrameForegroundMask.size() == info.Frame.size())
+        {
+            foreground = info.FrameForegroundMask;
+            object = objectDumpBuffer;
+            return;
+        }
+
+        // masks of downsampled frames
+        resize(info.FrameForegroundMask, foregroundScaleBuffer, info.Frame.size(), 0, 0, INTER_NEAREST);
+        resize(objectDumpBuffer, objectScaleBuffer, info.Frame.size(), 0, 0, INTER_NEAREST);
+        foreground = foregroundScaleBuffer;
+        object = objectScaleBuffer;
+    }
+
+
+    void FrameWriter::RunLoop()
+    {
+        const string extension = "." + imageType;
+
+        Mat foreground, object;
+        vector<FrameInfo> batch;
+        vector<string> fnames;
+        vector<vector<uchar>> files;
+        while (queue->PopBatch(batch, batchSize))
+        {
+            nBatchFrames = static_cast<int>(batch.size());
+
+            // encode all frames and recycle their buffers
+            fnames.resize(2 * batch.size());
+            files.resize(2 * batch.size());
+            for (size_t i = 0; i < batch.size(); ++i)
+            {
+                FrameInfo& info = batch[i];
+                try 
+                {
+                    PrepareMasks(info, foreground, object);
+
+                    fnames[2*i] = foregroundFolder + "/" + info.FrameName + extension;
+                    imencode(extension, foreground, files[2*i]);
+
+                    fnames[2*i+1] = maskFolder + "/" + info.FrameName + extension;
+                    imencode(extension, object, files[2*i+1]);
+                }
+                catch (exception& ex)
+                {
+                    cerr << "Exception dumping masks in " << extension << " format: " << ex.what() << endl;
+                    cerr << "Press ENTER to exit." << endl; cin.get();
+                    exit(EXIT_FAILURE);
+                }
+
+                info.ReleaseMats();
+                framePool.Release(std::move(info.Buffers));
+            }
+            batch.clear();
+
+            // write them
+            for (size_t i = 0; i < files.size(); ++i)
+            {
+                if (!WriteFileAtomic(fnames[i], files[i].data(), files[i].size())) 
+                {
+                    cerr << "Unable to save " << fnames[i] << endl;
+                }
+            }
+            nBatchFrames = 0;
+        }
+    }
+
+
+    void FrameWriter::RunArchiveLoop()
+    {
+        Mat foreground, object;
+        vector<FrameInfo> batch;
+        while (queue->PopBatch(batch, batchSize))
+        {
+            nBatchFrames = static_cast<int>(batch.size());
+            for (auto& info : batch)
+            {
+                PrepareMasks(info, foreground, object);
+                if (!archive.WriteFrame(info.FrameIndex, foreground, object))
+                {
+                    cerr << "Unable to archive masks of frame #" << info.FrameIndex << endl;
+                }
+
+                info.ReleaseMats();
+                framePool.Release(std::move(info.Buffers));
+                --nBatchFrames;
+            }
+            batch.clear();
+        }
+    }
+}
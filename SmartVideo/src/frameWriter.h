@@ -0,0 +1,87 @@
+#ifndef FRAMEWRITER_H
+#define FRAMEWRITER_H
+
+#include "ThreadUtil.h"
+#include "Workers.h"
+#include "framePool.h"
+#include "maskArchive.h"
+
+#include "opencv2/core/core.hpp"
+
+#include <string>
+#include <atomic>
+
+namespace SmartVideo
+{
+    struct FrameInfo;
+
+    /// Dumps foreground and object masks of processed frames on its own thread.
+    /// Frames are taken from a queue in batches, encoded, and then written atomically (temp file + rename).
+    /// Alternatively, all masks of a clip go into a single run-length encoded MaskArchive.
+    /// Buffers of every frame go back to the frame pool as soon as the frame has been encoded.
+    class FrameWriter
+    {
+        FramePool& framePool;
+        Util::ThreadSafeQueue<FrameInfo>* queue;
+
+        std::string foregroundFolder;
+        std::string maskFolder;
+        std::string imageType;
+        int batchSize;
+
+        /// Frames that have been taken from the queue, but not written yet
+        std::atomic<int> nBatchFrames;
+        bool isRunning;
+
+        /// Object mask, converted to 8 bit for encoding
+        cv::Mat objectDumpBuffer;
+        /// Masks, upsampled to the size of their frame (if they have been computed at a lower resolution)
+        cv::Mat foregroundScaleBuffer, objectScaleBuffer;
+
+        /// Receives all masks, if open
+        MaskArchiveWriter archive;
+
+        Util::WorkerPool writerPool;
+
+        /// Disallow copy ctor
+        FrameWriter(const FrameWriter&);
+        FrameWriter& operator=(const FrameWriter&);
+
+        /// Writer thread loop. Returns when the queue has been closed and drained.
+        void RunLoop();
+
+        /// Writer thread loop for archives.
+        void RunArchiveLoop();
+
+        /// Gets both masks of the given frame in the format they are dumped in (8 bit, at the resolution of the frame).
+        void PrepareMasks(const FrameInfo& info, cv::Mat& foreground, cv::Mat& object);
+
+    public:
+        FrameWriter(FramePool& framePool);
+
+        virtual ~FrameWriter()
+        {
+            Finish();
+        }
+
+        /// Starts writing all frames of the given queue into the given (existing) folders,
+        /// in the format of the given file extension (e.g. "bmp"), at most batchSize frames at a time.
+        void Start(Util::ThreadSafeQueue<FrameInfo>& queue, const std::string& foregroundFolder, 
+            const std::string& maskFolder, const std::string& imageType, int batchSize);
+
+        /// Starts writing all frames of the given queue into a new mask archive, 
+        /// that holds the frames [firstFrame, firstFrame + frameCount).
+        void StartArchive(Util::ThreadSafeQueue<FrameInfo>& queue, const std::string& archivePath, 
+            unsigned int firstFrame, unsigned int frameCount, int batchSize);
+
+        /// Closes the queue and waits until all remaining frames have been written (and the archive has been closed).
+        void Finish();
+
+        bool IsRunning() const { return isRunning; }
+
+        /// Amount of frames waiting to be written.
+        int GetQueueSize() const;
+    };
+}
+
+#endif // FRAMEWRITER_H
@@ -0,0 +1,83 @@
+#include "groupMatcher.h"
+
+namespace Matcher {
+
+    GroupMatcher::GroupMatcher(Util::WorkerPool* pool) {
+        setPool(pool);
+    }
+
+    void GroupMatcher::setPool(Util::WorkerPool* pool) {
+        this->pool = pool;
+        int nSolvers = 1 + (pool ? pool->GetWorkerCount() : 0);
+        solvers.resize(nSolvers);
+        for(auto& s: solvers) {
+            if(!s) s = std::unique_ptr<MatchSolvers>(new MatchSolvers());
+        }
+    }
+
+    long long GroupMatcher::solve(ClusterMatcher& cm, vector<pair<int,int>>& links, int gate, MatchMethod method) {
+        vector<int> lGroup, rGroup;
+        int nGroups = cm.decompose(gate, lGroup, rGroup);
+        vector<vector<int>> lMembers(nGroups), rMembers(nGroups);
+        for(size_t a=0; a<lGroup.size(); a++) lMembers[lGroup[a]].push_back(a);
+        for(size_t b=0; b<rGroup.size(); b++) rMembers[rGroup[b]].push_back(b);
+
+        // largest groups first, since their cost grows fastest
+        vector<int> order(nGroups);
+        for(int g=0; g<nGroups; g++) order[g] = g;
+        sort(order.begin(), order.end(), [&lMembers, &rMembers](int g, int h) {
+            return lMembers[g].size() + rMembers[g].size() > lMembers[h].size() + rMembers[h].size();
+        });
+
+        bool isDense = method==MatchMethod::Dense;
+        vector<MatchDuals> groupDuals(isDense ? nGroups : 0);
+        for(size_t g=0; g<groupDuals.size(); g++) {
+            groupDuals[g] = duals.select(lMembers[g], static_cast<int>(lGroup.size()));
+        }
+
+        vector<vector<pair<int,int>>> groupLinks(nGroups);
+        vector<long long> groupCost(nGroups);
+        auto solveGroups = [&](Util::JobIndex first, Util::JobIndex last, MatchSolvers& s) {
+            for(Util::JobIndex i=first; i<last; i++) {
+                int g = order[i];
+                ClusterMatcher group = cm.subMatcher(lMembers[g], rMembers[g]);
+                vector<pair<int,int>>& gl = groupLinks[g];
+                if(method==MatchMethod::Sparse) groupCost[g] = group.solveSparse(gl, gate, s.sparse);
+                else if(method==MatchMethod::Flow) groupCost[g] = group.solveFlow(gl, s.flow);
+                else groupCost[g] = group.solve(gl, s.hungarian, groupDuals[g]);
+
+                // back to the objects of the whole frame
+                for(auto& link: gl) {
+                    link.first = lMembers[g][link.first];
+                    link.second = rMembers[g][link.second];
+                }
+            }
+        };
+        if(pool) {
+            // every chunk (of one group) uses the solvers of the thread it runs on
+            pool->ParallelFor(0, nGroups, [this, &solveGroups](Util::JobIndex first, Util::JobIndex last) {
+                solveGroups(first, last, *solvers[pool->GetCurrentWorkerIndex()+1]);
+            }, 1);
+        } else {
+            solveGroups(0, nGroups, *solvers[0]);
+        }
+
+        if(isDense) {
+            duals.reset(static_cast<int>(rGroup.size()));
+            for(int g=0; g<nGroups; g++) duals.merge(groupDuals[g], rMembers[g]);
+        }
+
+        // every group's costs are on the scale of its own nodes, which add up to the nodes of the whole frame
+        long long cost = 0;
+        links.clear();
+        for(int g=0; g<nGroups; g++) {
+            cost += groupCost[g];
+            links.insert(links.end(), groupLinks[g].begin(), groupLinks[g].end());
+        }
+        stable_sort(links.begin(), links.end(), [](const pair<int,int>& l, const pair<int,int>& r) {
+            return l.second < r.second;
+        });
+        return cost;
+    }
+
+}
@@ -0,0 +1,57 @@
+#ifndef GROUPMATCHER_H
+#define GROUPMATCHER_H
+
+#include "matcher.h"
+#include "hungarian.h"
+#include "assignment.h"
+#include "minCostFlow.h"
+#include "Workers.h"
+
+#include <memory>
+#include <vector>
+
+namespace Matcher
+{
+    enum class MatchMethod
+    {
+        Dense,
+        Sparse,
+        Flow
+    };
+
+    /// Buffers of all matchers, to be used by one thread at a time.
+    struct MatchSolvers {
+        Hungarian::HungarianMethod hungarian;
+        Assignment::SparseAssignment sparse;
+        Flow::MinCostFlow flow;
+    };
+
+    /// Matches every group of objects (see ClusterMatcher::decompose) on its own, optionally on the workers of a pool.
+    /// Keeps one set of solvers for the calling thread and one per worker, so their buffers are reused from frame to frame.
+    /// Dense matching of every group is warm-started from the labels of the last frame's groups: groups change from
+    /// frame to frame, but their left objects are the right objects of the last frame, whose labels are kept for all of them.
+    class GroupMatcher {
+        Util::WorkerPool* pool;
+        vector<std::unique_ptr<MatchSolvers>> solvers;
+        MatchDuals duals;
+
+        /// Disallow copy ctor
+        GroupMatcher(const GroupMatcher&);
+        GroupMatcher& operator=(const GroupMatcher&);
+
+    public:
+        GroupMatcher(Util::WorkerPool* pool = nullptr);
+
+        /// Groups are matched on the workers of the given pool (if any), which must outlive this matcher.
+        void setPool(Util::WorkerPool* pool);
+
+        /// Forget the last frame, e.g. at the start of a new clip.
+        void clear() { duals.clear(); }
+
+        /// Matches the groups of objects at most gate pixels apart (no limit if gate<=0), and returns the total matching cost.
+        /// Links are ordered by right object, like the links of a single matching.
+        long long solve(ClusterMatcher& cm, vector<pair<int,int>>& links, int gate, MatchMethod method);
+    };
+}
+
+#endif // GROUPMATCHER_H
@@ -19,10 +19,11 @@ namespace Hungarian {
     }
     void HungarianMethod::add_sets(int x) {
         int i;
+        const int* c=w+x*yn;
         sets[x]=1;
         for(i=0;i<yn;i++) {
-            if(xlabel[x]+ylabel[i]-cost[x][i]<slack[i]) {
-                slack[i]=xlabel[x]+ylabel[i]-cost[x][i];
+            if(xlabel[x]+ylabel[i]-c[i]<slack[i]) {
+                slack[i]=xlabel[x]+ylabel[i]-c[i];
                 prev[i]=x;
             }
         }
@@ -50,47 +51,85 @@ namespace Hungarian {
         }
     }
 
-    void HungarianMethod::setCost(int x,int y,int c) {
-        cost[x][y]=c;
+    void HungarianMethod::resize(int xn,int yn) {
+        this->xn=xn;
+        this->yn=yn;
+        cost.assign(static_cast<size_t>(xn)*yn,0);
+        int mn=max(xn,yn);
+        sets.resize(mn);
+        sett.resize(mn);
+        xlabel.resize(mn);
+        ylabel.resize(mn);
+        xy.resize(mn);
+        yx.resize(mn);
+        slack.resize(mn);
+        prev.resize(mn);
     }
-    int HungarianMethod::getCost(int x,int y) {
-        return cost[x][y];
-    }
-    int HungarianMethod::maximumMatching() {
-        int i,j,c=0;
+    long long HungarianMethod::maximumMatching(bool warmStart) {
+        int i,j;
+        long long c=0;
         matched=0;
         // we must have "xn<yn"
-        bool swapxy=0;
-        if(xn>yn) {
-            swapxy=1;
-            int mn=max(xn,yn);
+        bool swapxy=xn>yn;
+        bool pad=warmStart && xn<yn;
+        int xn0=xn;
+        if(swapxy) {
+            transposed.resize(cost.size());
+            for(i=0;i<xn;i++)
+                for(j=0;j<yn;j++)
+                    transposed[j*xn+i]=cost[i*yn+j];
             swap(xn,yn);
-            for(int i=0;i<mn;i++)
-                for(int j=0;j<i;j++)
-                    swap(cost[i][j],cost[j][i]);
+            w=&transposed[0];
+        } else if(pad) {
+            // unmatched y would have to keep the lowest label, which the given labels do not guarantee
+            padded.assign(static_cast<size_t>(yn)*yn,0);
+            copy(cost.begin(),cost.end(),padded.begin());
+            xn=yn;
+            w=&padded[0];
+        } else {
+            w=cost.empty() ? nullptr : &cost[0];
         }
-        for(i=0;i<xn;i++) {
-            xy[i]=nil;
-            xlabel[i]=0;
-            for(j=0;j<yn;j++) xlabel[i]=max(cost[i][j],xlabel[i]);
+        if(warmStart && !swapxy) {
+            // lowest feasible xlabel for the given ylabel, so that every x has at least one tight edge
+            for(i=0;i<xn;i++) {
+                xy[i]=nil;
+                xlabel[i]=-inf;
+                for(j=0;j<yn;j++) xlabel[i]=max(w[i*yn+j]-ylabel[j],xlabel[i]);
+            }
+            for(i=0;i<yn;i++) yx[i]=nil;
+            // start with all tight edges that do not conflict, phases only augment the rest
+            for(i=0;i<xn;i++) {
+                for(j=0;j<yn;j++) {
+                    if(yx[j]==nil && xlabel[i]+ylabel[j]==w[i*yn+j]) {
+                        xy[i]=j; yx[j]=i; matched++;
+                        break;
+                    }
+                }
+            }
+        } else {
+            for(i=0;i<xn;i++) {
+                xy[i]=nil;
+                xlabel[i]=0;
+                for(j=0;j<yn;j++) xlabel[i]=max(w[i*yn+j],xlabel[i]);
+            }
+            for(i=0;i<yn;i++) {
+                yx[i]=nil;
+                ylabel[i]=0;
+            }
         }
-        for(i=0;i<yn;i++) {
-            yx[i]=nil;
-            ylabel[i]=0;
+        nPhases=xn-matched;
+        while(matched<xn) phase();
+        if(pad) {
+            // drop the padding
+            xn=xn0;
+            for(j=0;j<yn;j++) if(yx[j]>=xn) yx[j]=nil;
         }
-        for(i=0;i<xn;i++) phase();
-        for(i=0;i<xn;i++) c+=cost[i][xy[i]];
-        // recover cost matrix (if necessary)
+        for(i=0;i<xn;i++) c+=w[i*yn+xy[i]];
+        // map the matching (and labels) back to the original sides
         if(swapxy) {
-            int mn=max(xn,yn);
-            int tmp[MAXNUM];
             swap(xn,yn);
-            for(int i=0;i<mn;i++)
-                for(int j=0;j<i;j++)
-                    swap(cost[i][j],cost[j][i]);
-            memcpy(tmp,xy,sizeof(xy));
-            memcpy(xy,yx,sizeof(yx));
-            memcpy(yx,tmp,sizeof(tmp));
+            swap(xy,yx);
+            swap(xlabel,ylabel);
         }
         // need special recovery if we want more info than matching value
         return c;
@@ -2,56 +2,75 @@
 #define HUNGARIAN_H
 
 #include <cassert>
+#include <vector>
 
 namespace Hungarian {
 
-    const int MAXNUM = 300;
-
     const int nil = -1;
     const int inf = 100000000;
 
+    /// Maximum weight matching (Kuhn-Munkres, O(n^3)) on a dense xn x yn cost matrix.
+    /// There is no size limit: the matrix is one contiguous row-major buffer, and all other state is 
+    /// sized on resize(). Buffers keep their capacity, so one instance can solve many problems without reallocating.
     class HungarianMethod {
 
-        int xn,yn,matched;
-        //int cost[MAXNUM][MAXNUM];
-        int *cost[MAXNUM];
-        bool sets[MAXNUM]; // whether x is in set S
-        bool sett[MAXNUM]; // whether y is in set T
-        int xlabel[MAXNUM],ylabel[MAXNUM];
-        int xy[MAXNUM],yx[MAXNUM]; // matched with whom
-        int slack[MAXNUM];  // given y: min{xlabel[x]+ylabel[y]-cost[x][y]} | x not in S
-        int prev[MAXNUM]; // for augmenting matching
+        int xn,yn,matched,nPhases;
+        std::vector<int> cost;          // xn x yn
+        std::vector<int> transposed;    // yn x xn, if xn>yn
+        std::vector<int> padded;        // yn x yn, if a wide problem (xn<yn) is warm-started
+        const int* w;                   // matrix that is being solved (cost or transposed), xn x yn
+        std::vector<char> sets; // whether x is in set S
+        std::vector<char> sett; // whether y is in set T
+        std::vector<int> xlabel,ylabel;
+        std::vector<int> xy,yx; // matched with whom
+        std::vector<int> slack;  // given y: min{xlabel[x]+ylabel[y]-cost[x][y]} | x not in S
+        std::vector<int> prev; // for augmenting matching
 
         void relabel();
         void add_sets(int x);
         void augment(int final);
         void phase();
 
+        /// Disallow copy ctor
+        HungarianMethod(const HungarianMethod&);
+        HungarianMethod& operator=(const HungarianMethod&);
+
     public:
-        HungarianMethod(int xn,int yn):xn(xn),yn(yn) {
-            assert(xn<=MAXNUM && yn<=MAXNUM);
-            for(int i=0;i<xn;i++) {
-                cost[i] = new int[yn];
-                for(int j=0;j<yn;j++)
-                    cost[i][j]=0;
-            }
-            memset(sets,0,sizeof(sets));
-            memset(sett,0,sizeof(sett));
-        }
-        ~HungarianMethod() {
-            for(int i=0;i<xn;i++)
-                delete [] cost[i];
+        HungarianMethod(int xn = 0,int yn = 0):nPhases(0),w(nullptr) {
+            resize(xn,yn);
         }
 
-        void setCost(int x,int y,int c);
-        int getCost(int x,int y);
-        int getMatchX(int x) { return xy[x]; }
-        int getMatchY(int y) { return yx[y]; }
+        /// Starts a new problem of the given size, with all costs 0.
+        void resize(int xn,int yn);
+
+        int getXCount() const { return xn; }
+        int getYCount() const { return yn; }
 
-        int maximumMatching();
+        /// All costs of x, to be filled in directly.
+        int* costRow(int x) { return &cost[x*yn]; }
+
+        void setCost(int x,int y,int c) { cost[x*yn+y]=c; }
+        int getCost(int x,int y) const { return cost[x*yn+y]; }
+        int getMatchX(int x) const { return xy[x]; }
+        int getMatchY(int y) const { return yx[y]; }
+
+        /// Labels (dual variables) of the last matching. The ylabel of a new problem can be set after resize(),
+        /// to warm-start from a similar problem: maximumMatching(true) then begins with all tight edges under 
+        /// these labels (and xlabel as low as feasible), and only augments the remaining x.
+        /// The result is still optimal, whatever the labels are. Only square and wide problems (xn<=yn) are warm-started;
+        /// a y that stays unmatched would have to keep the lowest label for that, so wide problems are padded with 
+        /// zero-cost x to a square one, which matches every y.
+        int getXLabel(int x) const { return xlabel[x]; }
+        int getYLabel(int y) const { return ylabel[y]; }
+        void setYLabel(int y,int l) { ylabel[y]=l; }
+
+        long long maximumMatching(bool warmStart = false);
+        
+        /// Amount of augmenting phases of the last matching (x that were not matched from the start).
+        int getPhaseCount() const { return nPhases; }
         
     };
 
 }
 
-#endif // HUNGARIAN_H
\ No newline at end of file
+#endif // HUNGARIAN_H
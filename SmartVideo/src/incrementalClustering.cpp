@@ -0,0 +1,314 @@
+#include "incrementalClustering.h"
+
+#include <algorithm>
+#include <cmath>
+#include <climits>
+#include <cstdlib>
+
+namespace Agglomerative {
+
+    namespace {
+        bool isInside(const Box& b, const Point2D& p, int margin) {
+            return p.x >= b.x1-margin && p.x <= b.x2+margin && p.y >= b.y1-margin && p.y <= b.y2+margin;
+        }
+
+        double boxDist2(const Box& a, const Box& b) {
+            double dx = max(0, max(a.x1-b.x2, b.x1-a.x2));
+            double dy = max(0, max(a.y1-b.y2, b.y1-a.y2));
+            return dx*dx+dy*dy;
+        }
+
+        int floorDiv(int a, int b) {
+            return a >= 0 ? a/b : -((-a+b-1)/b);
+        }
+    }
+
+    void BoxGrid::build(const vector<Box>& boxes, int margin) {
+        int n = boxes.size();
+        nx = ny = 0;
+        first.assign(1, 0);
+        index.clear();
+        if(n == 0) return;
+
+        int x1 = INT_MAX, y1 = INT_MAX, x2 = INT_MIN, y2 = INT_MIN;
+        long long sides = 0;
+        for(int i=0; i<n; i++) {
+            const Box& b = boxes[i];
+            x1 = min(x1, b.x1-margin); x2 = max(x2, b.x2+margin);
+            y1 = min(y1, b.y1-margin); y2 = max(y2, b.y2+margin);
+            sides += (b.x2-b.x1) + (b.y2-b.y1) + 2*(2*margin+1);
+        }
+        x0 = x1;
+        y0 = y1;
+
+        // cells of about the mean box side, but a few cells per box at most
+        cell = max(1LL, sides/(2*n));
+        while(static_cast<long long>((x2-x0)/cell+1)*((y2-y0)/cell+1) > 4LL*n+16) cell *= 2;
+        nx = (x2-x0)/cell+1;
+        ny = (y2-y0)/cell+1;
+
+        // counting sort by cell, which keeps the boxes of every cell in increasing order
+        first.assign(nx*ny+1, 0);
+        int cx1, cy1, cx2, cy2;
+        for(int i=0; i<n; i++) {
+            cellsOf(boxes[i], margin, cx1, cy1, cx2, cy2);
+            for(int cx=cx1; cx<=cx2; cx++) for(int cy=cy1; cy<=cy2; cy++) first[cellAt(cx,cy)+1]++;
+        }
+        for(int c=0; c<nx*ny; c++) first[c+1] += first[c];
+        index.resize(first[nx*ny]);
+        vector<int> next(first.begin(), first.end()-1);
+        for(int i=0; i<n; i++) {
+            cellsOf(boxes[i], margin, cx1, cy1, cx2, cy2);
+            for(int cx=cx1; cx<=cx2; cx++) for(int cy=cy1; cy<=cy2; cy++) index[next[cellAt(cx,cy)]++] = i;
+        }
+    }
+
+    int BoxGrid::cellOf(int x, int y) const {
+        if(x < x0 || y < y0) return -1;
+        int cx = (x-x0)/cell, cy = (y-y0)/cell;
+        if(cx >= nx || cy >= ny) return -1;
+        return cellAt(cx, cy);
+    }
+
+    void BoxGrid::cellsOf(const Box& b, int margin, int& cx1, int& cy1, int& cx2, int& cy2) const {
+        cx1 = max(0, floorDiv(b.x1-margin-x0, cell));
+        cy1 = max(0, floorDiv(b.y1-margin-y0, cell));
+        cx2 = min(nx-1, floorDiv(b.x2+margin-x0, cell));
+        cy2 = min(ny-1, floorDiv(b.y2+margin-y0, cell));
+    }
+
+    vector<Result> IncrementalClustering::clusterFull(const vector<Point2D>& pts, double dthreshold, int cthreshold) {
+        wasFull = true;
+        nFramesSinceRefresh = 0;
+        return AgglomerativeClustering(pts).cluster(dthreshold, cthreshold);
+    }
+
+    bool IncrementalClustering::touches(const vector<Point2D>& pts, int a, int b, double dthreshold, int margin) {
+        // only pixels near the other node's box can be near its pixels
+        nearA.clear();
+        for(int j=nodeFirst[a]; j<nodeFirst[a+1]; j++) {
+            if(isInside(nodeBoxes[b], pts[nodePixels[j]], margin)) nearA.push_back(nodePixels[j]);
+        }
+        if(nearA.empty()) return false;
+        nearB.clear();
+        for(int j=nodeFirst[b]; j<nodeFirst[b+1]; j++) {
+            if(isInside(nodeBoxes[a], pts[nodePixels[j]], margin)) nearB.push_back(nodePixels[j]);
+        }
+        if(nearB.empty()) return false;
+
+        // pixels of b by cells of side margin, so pixels near a pixel of a are in the 3x3 cells around it
+        int side = max(1, margin);
+        int x0 = INT_MAX, y0 = INT_MAX, x1 = INT_MIN, y1 = INT_MIN;
+        for(size_t j=0; j<nearB.size(); j++) {
+            const Point2D& p = pts[nearB[j]];
+            x0 = min(x0, p.x); x1 = max(x1, p.x);
+            y0 = min(y0, p.y); y1 = max(y1, p.y);
+        }
+        int cols = (x1-x0)/side+1, rows = (y1-y0)/side+1;
+        cellHead.assign(cols*rows, -1);
+        cellNext.resize(nearB.size());
+        for(size_t j=0; j<nearB.size(); j++) {
+            const Point2D& p = pts[nearB[j]];
+            int c = (p.x-x0)/side*rows + (p.y-y0)/side;
+            cellNext[j] = cellHead[c];
+            cellHead[c] = j;
+        }
+
+        double thr2 = dthreshold * dthreshold;
+        for(size_t j=0; j<nearA.size(); j++) {
+            const Point2D& p = pts[nearA[j]];
+            int cx = floorDiv(p.x-x0, side), cy = floorDiv(p.y-y0, side);
+            for(int nx=max(0, cx-1); nx<=min(cols-1, cx+1); nx++) {
+                for(int ny=max(0, cy-1); ny<=min(rows-1, cy+1); ny++) {
+                    for(int m=cellHead[nx*rows+ny]; m>=0; m=cellNext[m]) {
+                        double dx = p.x-pts[nearB[m]].x, dy = p.y-pts[nearB[m]].y;
+                        if(dx*dx+dy*dy < thr2) return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    vector<Result> IncrementalClustering::cluster(const vector<Point2D>& pts, double dthreshold, int cthreshold) {
+        int n = pts.size();
+        int k = seeds.size();
+        if(k == 0 || ++nFramesSinceRefresh >= refreshInterval) {
+            return clusterFull(pts, dthreshold, cthreshold);
+        }
+
+        // assign pixels that lie in exactly one expanded seed box (only the boxes of the pixel's cell can hold it)
+        int margin = static_cast<int>(ceil(dthreshold));
+        seedGrid.build(seeds, margin);
+        nodeOf.assign(n, -1);
+        unseeded.clear();
+        unseededIndex.clear();
+        for(int i=0; i<n; i++) {
+            int iSeed = -1;
+            int c = seedGrid.cellOf(pts[i].x, pts[i].y);
+            if(c >= 0) {
+                for(const int* s=seedGrid.begin(c); s!=seedGrid.end(c); s++) {
+                    if(!isInside(seeds[*s], pts[i], margin)) continue;
+                    if(iSeed >= 0) {
+                        // ambiguous
+                        iSeed = -1;
+                        break;
+                    }
+                    iSeed = *s;
+                }
+            }
+            if(iSeed >= 0) {
+                nodeOf[i] = iSeed;
+            } else {
+                unseeded.push_back(pts[i]);
+                unseededIndex.push_back(i);
+            }
+        }
+        if(unseeded.size() > maxUnseededRatio * n) {
+            return clusterFull(pts, dthreshold, cthreshold);
+        }
+        wasFull = false;
+        double thr2 = dthreshold * dthreshold;
+
+        // pixels by seed
+        seedFirst.assign(k+1, 0);
+        for(int i=0; i<n; i++) {
+            if(nodeOf[i] >= 0) seedFirst[nodeOf[i]+1]++;
+        }
+        for(int s=0; s<k; s++) seedFirst[s+1] += seedFirst[s];
+        seedPixels.resize(seedFirst[k]);
+        vector<int> next(seedFirst.begin(), seedFirst.end()-1);
+        for(int i=0; i<n; i++) {
+            if(nodeOf[i] >= 0) seedPixels[next[nodeOf[i]]++] = i;
+        }
+
+        // split every seed into its connected parts, which are the first nodes: pixels are snapped to small cells,
+        // and two cells can be connected if their rectangles are closer than dthreshold (the forward offsets in reach).
+        // Cells next to each other are closer than that anyway, so cells farther apart are only compared on the border
+        // of the occupied cells. Parts that should be connected, but are not, are joined by the merge below.
+        int side = max(1, static_cast<int>(dthreshold / 4));
+        bool nextIsNear = 2.0*(2*side-1)*(2*side-1) < thr2;
+        int reach = static_cast<int>(ceil(dthreshold / side)) + 1;
+        // the cells next to a cell come first
+        vector<pair<int,int>> offsets;
+        offsets.push_back(make_pair(0, 1));
+        offsets.push_back(make_pair(1, -1));
+        offsets.push_back(make_pair(1, 0));
+        offsets.push_back(make_pair(1, 1));
+        const size_t nNeighbours = offsets.size();
+        for(int dx=0; dx<=reach; dx++) {
+            for(int dy=-reach; dy<=reach; dy++) {
+                if((dx == 0 && dy <= 0) || (dx <= 1 && abs(dy) <= 1)) continue;
+                double gx = max(0, dx-1) * side, gy = max(0, abs(dy)-1) * side;
+                if(gx*gx + gy*gy < thr2) offsets.push_back(make_pair(dx, dy));
+            }
+        }
+        int nNodes = 0;
+        nextPixel.resize(seedPixels.size());
+        for(int s=0; s<k; s++) {
+            if(seedFirst[s] == seedFirst[s+1]) continue;
+            int x1 = seeds[s].x1-margin, y1 = seeds[s].y1-margin;
+            int snx = (seeds[s].x2+margin-x1)/side+1, sny = (seeds[s].y2+margin-y1)/side+1;
+            partCell.assign(snx*sny, -1);
+            occupied.clear();
+            cellFirstPixel.clear();
+            for(int j=seedFirst[s]; j<seedFirst[s+1]; j++) {
+                const Point2D& p = pts[seedPixels[j]];
+                int c = (p.x-x1)/side*sny + (p.y-y1)/side;
+                if(partCell[c] < 0) {
+                    partCell[c] = occupied.size();
+                    occupied.push_back(c);
+                    cellFirstPixel.push_back(-1);
+                }
+                nextPixel[j] = cellFirstPixel[partCell[c]];
+                cellFirstPixel[partCell[c]] = j;
+            }
+            auto cellsTouch = [&](int a, int b) -> bool {
+                for(int i=cellFirstPixel[a]; i>=0; i=nextPixel[i]) {
+                    for(int j=cellFirstPixel[b]; j>=0; j=nextPixel[j]) {
+                        double dx = pts[seedPixels[i]].x-pts[seedPixels[j]].x, dy = pts[seedPixels[i]].y-pts[seedPixels[j]].y;
+                        if(dx*dx+dy*dy < thr2) return true;
+                    }
+                }
+                return false;
+            };
+            onBorder.assign(occupied.size(), 0);
+            for(size_t j=0; j<occupied.size(); j++) {
+                int cx = occupied[j]/sny, cy = occupied[j]%sny;
+                for(int nx=cx-1; nx<=cx+1 && !onBorder[j]; nx++) {
+                    for(int ny=cy-1; ny<=cy+1; ny++) {
+                        if(nx < 0 || nx >= snx || ny < 0 || ny >= sny || partCell[nx*sny+ny] < 0) {
+                            onBorder[j] = 1;
+                            break;
+                        }
+                    }
+                }
+            }
+            partSets.reset(occupied.size());
+            for(size_t j=0; j<occupied.size(); j++) {
+                int cx = occupied[j]/sny, cy = occupied[j]%sny;
+                size_t nOffsets = onBorder[j] ? offsets.size() : nNeighbours;
+                for(size_t d=0; d<nOffsets; d++) {
+                    int nx = cx+offsets[d].first, ny = cy+offsets[d].second;
+                    if(nx >= snx || ny < 0 || ny >= sny) continue;
+                    int other = partCell[nx*sny+ny];
+                    if(other < 0 || (d >= nNeighbours && !onBorder[other])) continue;
+                    if(partSets.getrep(static_cast<int>(j)) == partSets.getrep(other)) continue;
+                    if((d < nNeighbours && nextIsNear) || cellsTouch(static_cast<int>(j), other)) partSets.merge(static_cast<int>(j), other);
+                }
+            }
+            partOf.assign(occupied.size(), -1);
+            for(int j=seedFirst[s]; j<seedFirst[s+1]; j++) {
+                int i = seedPixels[j];
+                int part = partSets.getrep(partCell[(pts[i].x-x1)/side*sny + (pts[i].y-y1)/side]);
+                if(partOf[part] < 0) partOf[part] = nNodes++;
+                nodeOf[i] = partOf[part];
+            }
+        }
+
+        // cluster the rest: new nodes follow the seeded parts
+        vector<Result> newClusters = AgglomerativeClustering(unseeded).cluster(dthreshold, 0);
+        int nSeeded = nNodes;
+        for(size_t j=0; j<newClusters.size(); j++) {
+            nodeOf[unseededIndex[j]] = nSeeded + newClusters[j].id;
+            nNodes = max(nNodes, nSeeded + newClusters[j].id + 1);
+        }
+
+        // actual extents and pixels of all nodes
+        nodeBoxes.assign(nNodes, Box(INT_MAX, INT_MAX, INT_MIN, INT_MIN));
+        nodeFirst.assign(nNodes+1, 0);
+        for(int i=0; i<n; i++) {
+            Box& b = nodeBoxes[nodeOf[i]];
+            b.x1 = min(b.x1, pts[i].x); b.x2 = max(b.x2, pts[i].x);
+            b.y1 = min(b.y1, pts[i].y); b.y2 = max(b.y2, pts[i].y);
+            nodeFirst[nodeOf[i]+1]++;
+        }
+        for(int a=0; a<nNodes; a++) nodeFirst[a+1] += nodeFirst[a];
+        nodePixels.resize(n);
+        next.assign(nodeFirst.begin(), nodeFirst.end()-1);
+        for(int i=0; i<n; i++) nodePixels[next[nodeOf[i]]++] = i;
+
+        // merge nodes by pixel distance: a node closer than dthreshold to node a shares a cell with a's box expanded by margin
+        DisjointSet<int> djs(nNodes);
+        nodeGrid.build(nodeBoxes, 0);
+        nodeSeen.assign(nNodes, -1);
+        for(int a=0; a<nNodes; a++) {
+            int cx1, cy1, cx2, cy2;
+            nodeGrid.cellsOf(nodeBoxes[a], margin, cx1, cy1, cx2, cy2);
+            for(int cx=cx1; cx<=cx2; cx++) {
+                for(int cy=cy1; cy<=cy2; cy++) {
+                    int c = nodeGrid.cellAt(cx, cy);
+                    for(const int* b=nodeGrid.begin(c); b!=nodeGrid.end(c); b++) {
+                        if(*b <= a || nodeSeen[*b] == a) continue;
+                        nodeSeen[*b] = a;
+                        if(djs.getrep(a) == djs.getrep(*b) || boxDist2(nodeBoxes[a], nodeBoxes[*b]) >= thr2) continue;
+                        if(touches(pts, a, *b, dthreshold, margin)) djs.merge(a, *b);
+                    }
+                }
+            }
+        }
+
+        return labelComponents(pts, [this, &djs](int i) { return djs.getrep(nodeOf[i]); }, nNodes, cthreshold);
+    }
+
+}
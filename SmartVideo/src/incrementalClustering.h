@@ -0,0 +1,117 @@
+#ifndef INCREMENTALCLUSTERING_H
+#define INCREMENTALCLUSTERING_H
+
+#include "agglomerative.h"
+
+#include <vector>
+
+namespace Agglomerative
+{
+    /// Axis-aligned bounding box of a cluster (inclusive).
+    struct Box {
+        int x1,y1,x2,y2;
+        Box(int x1,int y1,int x2,int y2):x1(x1),y1(y1),x2(x2),y2(y2) {}
+    };
+
+    /// Boxes bucketed by a grid of square cells: every box is listed in all cells it covers,
+    /// so the boxes near a point or a box are found without testing every box.
+    class BoxGrid {
+        int cell,x0,y0,nx,ny;
+        vector<int> first;      // boxes of cell c are index[first[c]..first[c+1])
+        vector<int> index;
+
+    public:
+        BoxGrid():cell(1),x0(0),y0(0),nx(0),ny(0) {}
+
+        /// Lists all boxes, expanded by margin on every side.
+        void build(const vector<Box>& boxes, int margin);
+
+        /// Cell of a point, or -1 outside of the grid.
+        int cellOf(int x,int y) const;
+
+        /// Cells covered by a box expanded by margin (empty, if cx1>cx2 or cy1>cy2).
+        void cellsOf(const Box& b, int margin, int& cx1, int& cy1, int& cx2, int& cy2) const;
+        int cellAt(int cx,int cy) const { return cx*ny+cy; }
+
+        const int* begin(int c) const { return index.data()+first[c]; }
+        const int* end(int c) const { return index.data()+first[c+1]; }
+    };
+
+    /// Clustering that re-uses the objects of the previous frame:
+    /// Every previous bounding box, expanded by dthreshold, seeds one cluster. A pixel that lies in exactly one 
+    /// expanded box joins that cluster without any distance test. The pixels of every seed are then split into
+    /// connected parts on a grid of cells of side dthreshold/4: cells next to each other are always connected,
+    /// and cells farther apart (on the border of the occupied cells only) if two of their pixels are closer than
+    /// dthreshold. Only the remaining pixels (outside of all boxes, or inside of overlapping boxes) are clustered
+    /// by AgglomerativeClustering. Finally, all parts and new clusters are merged, if any of their pixels are
+    /// closer than dthreshold (only nodes whose bounding boxes are that close are compared, and only by their
+    /// pixels near the other node's box).
+    /// 
+    /// Parts only ever join pixels that are connected, and the final merge finds every pair of close pixels
+    /// in different nodes, so the clusters are the same as those of AgglomerativeClustering. The cost depends
+    /// on the seeds, though: many nodes near each other (e.g. with noise) are compared pair by pair. To keep that
+    /// in bounds, the whole frame is re-clustered every refreshInterval frames, and whenever more than
+    /// maxUnseededRatio of all pixels are not seeded.
+    class IncrementalClustering
+    {
+        int refreshInterval;
+        double maxUnseededRatio;
+        int nFramesSinceRefresh;
+        bool wasFull;
+
+        vector<Box> seeds;
+
+        // buffers
+        BoxGrid seedGrid;
+        BoxGrid nodeGrid;
+        vector<int> nodeOf;
+        vector<int> seedFirst;
+        vector<int> seedPixels;
+        vector<int> partCell;
+        vector<int> occupied;
+        vector<char> onBorder;
+        vector<int> cellFirstPixel;
+        vector<int> nextPixel;
+        vector<int> partOf;
+        DisjointSet<int> partSets;
+        vector<Point2D> unseeded;
+        vector<int> unseededIndex;
+        vector<Box> nodeBoxes;
+        vector<int> nodeSeen;
+        vector<int> nodeFirst;
+        vector<int> nodePixels;
+        vector<int> nearA, nearB;
+        vector<int> cellHead;
+        vector<int> cellNext;
+
+        vector<Result> clusterFull(const vector<Point2D>& pts, double dthreshold, int cthreshold);
+
+        /// Whether any pixel of node a is closer than dthreshold (<= margin) to any pixel of node b.
+        bool touches(const vector<Point2D>& pts, int a, int b, double dthreshold, int margin);
+
+    public:
+        IncrementalClustering(int refreshInterval = 30, double maxUnseededRatio = 0.5):
+            refreshInterval(refreshInterval),
+            maxUnseededRatio(maxUnseededRatio),
+            nFramesSinceRefresh(0),
+            wasFull(false) {}
+
+        /// Forget all seeds, so the next frame is clustered from scratch.
+        void reset() {
+            seeds.clear();
+            nFramesSinceRefresh = 0;
+        }
+
+        /// Seeds for the next frame (usually the objects of the current frame).
+        void clearSeeds() { seeds.clear(); }
+        void addSeed(int x1,int y1,int x2,int y2) { seeds.push_back(Box(x1,y1,x2,y2)); }
+
+        /// Same interface and result format as AgglomerativeClustering::cluster.
+        vector<Result> cluster(const vector<Point2D>& pts, double dthreshold, int cthreshold);
+
+        /// Whether the last frame has been clustered from scratch.
+        bool lastWasFull() const { return wasFull; }
+    };
+}
+
+#endif // INCREMENTALCLUSTERING_H
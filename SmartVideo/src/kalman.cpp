@@ -0,0 +1,75 @@
+#include "kalman.h"
+
+#include <algorithm>
+
+namespace Tracking
+{
+    void KalmanTracks::Predict()
+    {
+        // x' = x + v, P' = F P F^T + Q, with F = [1 1; 0 1] and Q = q [1/4 1/2; 1/2 1] (white noise acceleration)
+        int n = tracks.size();
+        if (n == 0) return;
+        float q = processNoise;
+        float* x = &tracks.x[0];
+        float* y = &tracks.y[0];
+        const float* vx = &tracks.vx[0];
+        const float* vy = &tracks.vy[0];
+        float* pxx = &tracks.pxx[0];
+        float* pxv = &tracks.pxv[0];
+        float* pvv = &tracks.pvv[0];
+        for (int i = 0; i < n; ++i)
+        {
+            x[i] += vx[i];
+            y[i] += vy[i];
+            pxx[i] += 2 * pxv[i] + pvv[i] + 0.25f * q;
+            pxv[i] += pvv[i] + 0.5f * q;
+            pvv[i] += q;
+        }
+    }
+
+    void KalmanTracks::BeginUpdate(int nObjects)
+    {
+        next.resize(nObjects);
+    }
+
+    void KalmanTracks::ContinueTrack(int j, int i, float zx, float zy)
+    {
+        // measure position only: S = Pxx + R, K = [Pxx; Pxv] / S
+        float s = tracks.pxx[i] + measurementNoise;
+        float kx = tracks.pxx[i] / s;
+        float kv = tracks.pxv[i] / s;
+        float ex = zx - tracks.x[i];
+        float ey = zy - tracks.y[i];
+
+        next.x[j] = tracks.x[i] + kx * ex;
+        next.y[j] = tracks.y[i] + kx * ey;
+        next.vx[j] = tracks.vx[i] + kv * ex;
+        next.vy[j] = tracks.vy[i] + kv * ey;
+        next.pxx[j] = (1 - kx) * tracks.pxx[i];
+        next.pxv[j] = (1 - kx) * tracks.pxv[i];
+        next.pvv[j] = tracks.pvv[i] - kv * tracks.pxv[i];
+    }
+
+    void KalmanTracks::StartTrack(int j, float zx, float zy)
+    {
+        next.x[j] = zx;
+        next.y[j] = zy;
+        next.vx[j] = 0;
+        next.vy[j] = 0;
+        next.pxx[j] = measurementNoise;
+        next.pxv[j] = 0;
+        next.pvv[j] = initialVelocityVariance;
+    }
+
+    void KalmanTracks::EndUpdate()
+    {
+        // swap keeps the capacity of both sets
+        std::swap(tracks.x, next.x);
+        std::swap(tracks.y, next.y);
+        std::swap(tracks.vx, next.vx);
+        std::swap(tracks.vy, next.vy);
+        std::swap(tracks.pxx, next.pxx);
+        std::swap(tracks.pxv, next.pxv);
+        std::swap(tracks.pvv, next.pvv);
+    }
+}
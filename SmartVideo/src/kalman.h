@@ -0,0 +1,80 @@
+#ifndef KALMAN_H
+#define KALMAN_H
+
+#include <vector>
+
+namespace Tracking
+{
+    /// Constant-velocity Kalman filters of all tracked objects, one track per object of the last frame.
+    /// Both axes use the same noise and are measured together, so they share one 2x2 (position, velocity)
+    /// covariance. All state is kept as structure of arrays, and Predict() is one pass over plain float arrays.
+    ///
+    /// Per frame: Predict() moves every track one frame ahead, then the tracks of the new frame's objects are
+    /// built between BeginUpdate() and EndUpdate(), either continuing a (predicted) track with a new measurement,
+    /// or starting a new one. SmartVideo::TrackStore owns the filters, and decides which track continues which.
+    class KalmanTracks
+    {
+        struct TrackArrays
+        {
+            std::vector<float> x, y;        // position (row, column)
+            std::vector<float> vx, vy;      // velocity, per frame
+            std::vector<float> pxx, pxv, pvv; // covariance of (position, velocity), same for both axes
+
+            void resize(int n)
+            {
+                x.resize(n); y.resize(n);
+                vx.resize(n); vy.resize(n);
+                pxx.resize(n); pxv.resize(n); pvv.resize(n);
+            }
+            int size() const { return static_cast<int>(x.size()); }
+        };
+
+        float processNoise;         // variance of the (random) acceleration per frame
+        float measurementNoise;     // variance of a measured position
+        float initialVelocityVariance;
+
+        TrackArrays tracks, next;
+
+    public:
+        KalmanTracks(float processNoise = 4.0f, float measurementNoise = 25.0f, float initialVelocityVariance = 100.0f) :
+            processNoise(processNoise),
+            measurementNoise(measurementNoise),
+            initialVelocityVariance(initialVelocityVariance)
+        {
+        }
+
+        /// Drops all tracks.
+        void Clear()
+        {
+            tracks.resize(0);
+            next.resize(0);
+        }
+
+        int GetTrackCount() const { return tracks.size(); }
+
+        /// Moves all tracks one frame ahead.
+        void Predict();
+
+        /// Predicted position of the given track.
+        float GetX(int i) const { return tracks.x[i]; }
+        float GetY(int i) const { return tracks.y[i]; }
+
+        /// Variance of the difference between a new measurement and the predicted position (per axis).
+        /// A measurement more than k*sqrt(variance) away is unlikely to belong to this track.
+        float GetInnovationVariance(int i) const { return tracks.pxx[i] + measurementNoise; }
+
+        /// Starts building the tracks of a new frame with the given amount of objects.
+        void BeginUpdate(int nObjects);
+
+        /// Object j of the new frame continues (predicted) track i, and has been measured at (zx, zy).
+        void ContinueTrack(int j, int i, float zx, float zy);
+
+        /// Object j of the new frame starts a new track at (zx, zy), without known velocity.
+        void StartTrack(int j, float zx, float zy);
+
+        /// The new frame's tracks replace the current ones.
+        void EndUpdate();
+    };
+}
+
+#endif // KALMAN_H
@@ -1,6 +1,8 @@
 #include "SmartVideo.h"
 
 #include <chrono>
+#include <thread>
+#include <atomic>
 
 using namespace std;
 using namespace SmartVideo;
@@ -18,6 +20,64 @@ public:
     X() {}
 };
 
+/// Process all clips, using nParallelClips processors at once.
+/// Divides the thread budget between the processors' own threads and OpenCV's internal threads.
+/// Returns the total amount of processed frames.
+Util::JobIndex ProcessClipsInParallel(int nParallelClips)
+{
+    int nBudget = Config.ThreadBudget;
+    if (nBudget <= 0)
+    {
+        nBudget = max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+    }
+
+    // busy threads of every processor: processing, pipeline stages and writer (read threads mostly wait for I/O),
+    // plus the workers of its clustering or matching pool (never busy at the same time, since both run in the tracking step)
+    int nClipThreads = 1 + (Config.PipelineStages ? SmartVideoProcessor::NPipelineStages : 0) + 1;
+    nClipThreads += max(Config.ClusteringThreads > 1 ? Config.ClusteringThreads : 0, Config.MatchingThreads > 1 ? Config.MatchingThreads : 0);
+    int nReadThreads = max(1, min(Config.NReadThreads, nBudget / nParallelClips - nClipThreads));
+    int nCVThreads = max(1, nBudget - nParallelClips * (nClipThreads + nReadThreads));
+    cv::setNumThreads(nCVThreads);
+
+    // processors share the console and cannot share HighGUI windows;
+    // all of them refer to this one copy, which outlives them (see clipPool.Join)
+    SmartVideoConfig clipConfig = Config;
+    clipConfig.NReadThreads = nReadThreads;
+    clipConfig.ShowProgress = false;
+    clipConfig.DisplayFrames = false;
+
+    cout << "Processing " << Config.ClipEntries.size() << " clips, " << nParallelClips << " at a time (" 
+        << nReadThreads << " read threads per clip, " << nCVThreads << " OpenCV threads)..." << endl << endl;
+
+    // every task owns a processor, and takes the next clip until none are left
+    std::atomic<int> iNextClip(0);
+    std::vector<ClipStats> stats(Config.ClipEntries.size());
+    Util::WorkerPool clipPool(nParallelClips);
+    for (int i = 0; i < nParallelClips; ++i)
+    {
+        clipPool.Submit([&clipConfig, &iNextClip, &stats]() {
+            SmartVideoProcessor processor(clipConfig);
+            int iClip;
+            while ((iClip = iNextClip++) < static_cast<int>(Config.ClipEntries.size()))
+            {
+                stats[iClip] = processor.ProcessClip(Config.ClipEntries[iClip]);
+            }
+        });
+    }
+    clipPool.Join();
+
+    Util::JobIndex nTotalFrames = 0;
+    for (auto& clipStats : stats)
+    {
+        cout << setw(30) << left << clipStats.Name << right << setw(8) << clipStats.FrameCount << " frames in " 
+            << setw(8) << clipStats.Seconds << " s (" << clipStats.GetFps() << " frames/s)" << endl;
+        nTotalFrames += clipStats.FrameCount;
+    }
+    cout << endl;
+    return nTotalFrames;
+}
+
+
 int main(int argc, char* argv[])
 {
     // setup config
@@ -25,10 +85,10 @@ int main(int argc, char* argv[])
     Config.CfgFile = "config.json";
 
     // some processor-specific things
+    Config.ShowProgress = true;
     Config.ProgressBarLen = 50;
     Config.MaxIOQueueSize = 50;
-    //Config.NReadThreads = 8;
-    Config.NReadThreads = 1;
+    Config.NReadThreads = 8;
 
     if (!Config.InitializeConfig() || Config.ClipEntries.size() == 0)
     {
@@ -38,20 +98,33 @@ int main(int argc, char* argv[])
     }
 
     
-    // create new processor
-    Processor = std::unique_ptr<SmartVideoProcessor>(new SmartVideoProcessor(Config));
-
-
     std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
-    for (auto clip : Config.ClipEntries)
+    Util::JobIndex nTotalFrames = 0;
+    int nParallelClips = min(Config.ParallelClips, static_cast<int>(Config.ClipEntries.size()));
+    if (nParallelClips <= 1)
     {
-        // process image sequence
-        Processor->ProcessClip(clip);
+        // create new processor
+        Processor = std::unique_ptr<SmartVideoProcessor>(new SmartVideoProcessor(Config));
+
+        for (auto& clip : Config.ClipEntries)
+        {
+            // process image sequence
+            nTotalFrames += Processor->ProcessClip(clip).FrameCount;
+        }
+    }
+    else
+    {
+        nTotalFrames = ProcessClipsInParallel(nParallelClips);
     }
 
     std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
     auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(now - start ).count();
-    cout << "Processing (with " << Config.NReadThreads << " read threads) took: " << millis/1000.f << " s." << endl << endl;
+    cout << "Processing (" << nParallelClips << " clip(s) at a time) took: " << millis/1000.f << " s";
+    if (millis > 0)
+    {
+        cout << " (" << nTotalFrames * 1000.f / millis << " frames/s)";
+    }
+    cout << "." << endl << endl;
 
     cerr << "Press ENTER to exit." << endl; cin.get();
 
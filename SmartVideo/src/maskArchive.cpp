@@ -0,0 +1,254 @@
+#include "maskArchive.h"
+
+#include <cstring>
+#include <cstdio>
+#include <iostream>
+
+using namespace std;
+
+namespace SmartVideo
+{
+    namespace
+    {
+        void PutVarint(vector<unsigned char>& out, unsigned int value)
+        {
+            while (value >= 0x80)
+            {
+                out.push_back(static_cast<unsigned char>(value | 0x80));
+                value >>= 7;
+            }
+            out.push_back(static_cast<unsigned char>(value));
+        }
+
+        bool GetVarint(const unsigned char*& p, const unsigned char* end, unsigned int& value)
+        {
+            value = 0;
+            for (int shift = 0; p < end && shift < 35; shift += 7)
+            {
+                unsigned char b = *p++;
+                value |= static_cast<unsigned int>(b & 0x7f) << shift;
+                if (!(b & 0x80)) return true;
+            }
+            return false;
+        }
+
+        void EncodeForeground(const cv::Mat& mask, vector<unsigned char>& out)
+        {
+            bool isForeground = false;
+            unsigned int run = 0;
+            for (int y = 0; y < mask.rows; ++y)
+            {
+                const unsigned char* row = mask.ptr<unsigned char>(y);
+                for (int x = 0; x < mask.cols; ++x)
+                {
+                    if ((row[x] != 0) != isForeground)
+                    {
+                        PutVarint(out, run);
+                        isForeground = !isForeground;
+                        run = 0;
+                    }
+                    ++run;
+                }
+            }
+            PutVarint(out, run);
+        }
+
+        bool DecodeForeground(const unsigned char*& p, const unsigned char* end, cv::Mat& mask)
+        {
+            unsigned char* pixels = mask.ptr<unsigned char>(0);
+            size_t nPixels = mask.total();
+            unsigned char value = 0;
+            for (size_t i = 0; i < nPixels; value ^= 255)
+            {
+                unsigned int run;
+                if (!GetVarint(p, end, run) || run > nPixels - i) return false;
+                memset(pixels + i, value, run);
+                i += run;
+            }
+            return true;
+        }
+
+        void EncodeObjects(const cv::Mat& mask, vector<unsigned char>& out)
+        {
+            const unsigned char* last = nullptr;
+            unsigned int run = 0;
+            for (int y = 0; y < mask.rows; ++y)
+            {
+                const unsigned char* row = mask.ptr<unsigned char>(y);
+                for (int x = 0; x < mask.cols; ++x)
+                {
+                    const unsigned char* pixel = row + 3 * x;
+                    if (last && memcmp(pixel, last, 3) != 0)
+                    {
+                        PutVarint(out, run);
+                        out.insert(out.end(), last, last + 3);
+                        run = 0;
+                    }
+                    last = pixel;
+                    ++run;
+                }
+            }
+            if (last)
+            {
+                PutVarint(out, run);
+                out.insert(out.end(), last, last + 3);
+            }
+        }
+
+        bool DecodeObjects(const unsigned char*& p, const unsigned char* end, cv::Mat& mask)
+        {
+            unsigned char* pixels = mask.ptr<unsigned char>(0);
+            size_t nPixels = mask.total();
+            for (size_t i = 0; i < nPixels; )
+            {
+                unsigned int run;
+                if (!GetVarint(p, end, run) || run > nPixels - i || end - p < 3) return false;
+                for (unsigned char* pixel = pixels + 3 * i; run > 0; --run, pixel += 3, ++i)
+                {
+                    memcpy(pixel, p, 3);
+                }
+                p += 3;
+            }
+            return true;
+        }
+    }
+
+
+    bool MaskArchiveWriter::Create(const std::string& fname, unsigned int firstFrame, unsigned int frameCount)
+    {
+        Close();
+
+        this->fname = fname;
+        file.open(fname + ".tmp", ofstream::out | ofstream::binary | ofstream::trunc);
+        if (!file) return false;
+
+        memcpy(header.Magic, "SVMA", 4);
+        header.Version = MaskArchiveHeader::CurrentVersion;
+        header.Width = header.Height = 0;
+        header.FirstFrame = firstFrame;
+        header.FrameCount = frameCount;
+        header.IndexOffset = 0;
+
+        MaskArchiveIndexEntry missing = { 0, 0, 0 };
+        index.assign(frameCount, missing);
+
+        // header is written again on Close()
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        offset = sizeof(header);
+        return !!file;
+    }
+
+    void MaskArchiveWriter::Close()
+    {
+        if (!file.is_open()) return;
+
+        header.IndexOffset = offset;
+        if (!index.empty())
+        {
+            file.write(reinterpret_cast<const char*>(&index[0]), index.size() * sizeof(MaskArchiveIndexEntry));
+        }
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        bool isWritten = !!file;
+        file.close();
+
+        string tmpName = fname + ".tmp";
+        if (!isWritten || !Util::RenameFile(tmpName, fname))
+        {
+            cerr << "WARNING: Unable to write mask archive " << fname << endl;
+            remove(tmpName.c_str());
+        }
+        index.clear();
+    }
+
+    bool MaskArchiveWriter::WriteFrame(unsigned int iFrame, const cv::Mat& foregroundMask, const cv::Mat& objectMask)
+    {
+        if (!file.is_open() || iFrame < header.FirstFrame || iFrame - header.FirstFrame >= header.FrameCount)
+        {
+            return false;
+        }
+
+        if (header.Width == 0)
+        {
+            header.Width = foregroundMask.cols;
+            header.Height = foregroundMask.rows;
+        }
+        if (foregroundMask.type() != CV_8U || objectMask.type() != CV_8UC3 ||
+            foregroundMask.cols != static_cast<int>(header.Width) || foregroundMask.rows != static_cast<int>(header.Height) ||
+            objectMask.cols != foregroundMask.cols || objectMask.rows != foregroundMask.rows)
+        {
+            return false;
+        }
+
+        record.clear();
+        EncodeForeground(foregroundMask, record);
+        EncodeObjects(objectMask, record);
+
+        file.write(reinterpret_cast<const char*>(&record[0]), record.size());
+        if (!file) return false;
+
+        MaskArchiveIndexEntry& entry = index[iFrame - header.FirstFrame];
+        entry.Offset = offset;
+        entry.Size = static_cast<unsigned int>(record.size());
+        offset += record.size();
+        return true;
+    }
+
+
+    bool MaskArchiveReader::Open(const std::string& fname)
+    {
+        Close();
+
+        if (!file.OpenRead(fname) || file.GetSize() < sizeof(MaskArchiveHeader))
+        {
+            file.Close();
+            return false;
+        }
+
+        const MaskArchiveHeader* h = reinterpret_cast<const MaskArchiveHeader*>(file.GetData());
+        bool isUsable = 
+            memcmp(h->Magic, "SVMA", 4) == 0 &&
+            h->Version == MaskArchiveHeader::CurrentVersion &&
+            h->IndexOffset >= sizeof(MaskArchiveHeader) &&
+            h->IndexOffset + h->FrameCount * sizeof(MaskArchiveIndexEntry) <= file.GetSize();
+        if (!isUsable)
+        {
+            file.Close();
+            return false;
+        }
+
+        header = h;
+        index = reinterpret_cast<const MaskArchiveIndexEntry*>(file.GetData() + h->IndexOffset);
+        return true;
+    }
+
+    void MaskArchiveReader::Close()
+    {
+        file.Close();
+        header = nullptr;
+        index = nullptr;
+    }
+
+    bool MaskArchiveReader::HasFrame(unsigned int iFrame) const
+    {
+        return header && 
+            iFrame >= header->FirstFrame && 
+            iFrame - header->FirstFrame < header->FrameCount && 
+            index[iFrame - header->FirstFrame].Offset != 0;
+    }
+
+    bool MaskArchiveReader::ReadFrame(unsigned int iFrame, cv::Mat& foregroundMask, cv::Mat& objectMask) const
+    {
+        if (!HasFrame(iFrame)) return false;
+
+        const MaskArchiveIndexEntry& entry = index[iFrame - header->FirstFrame];
+        if (entry.Offset + entry.Size > header->IndexOffset) return false;
+
+        const unsigned char* p = file.GetData() + entry.Offset;
+        const unsigned char* end = p + entry.Size;
+
+        foregroundMask.create(header->Height, header->Width, CV_8U);
+        objectMask.create(header->Height, header->Width, CV_8UC3);
+        return DecodeForeground(p, end, foregroundMask) && DecodeObjects(p, end, objectMask);
+    }
+}
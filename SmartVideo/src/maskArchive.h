@@ -0,0 +1,117 @@
+#ifndef MASKARCHIVE_H
+#define MASKARCHIVE_H
+
+#include "FileUtil.h"
+
+#include "opencv2/core/core.hpp"
+
+#include <fstream>
+#include <vector>
+
+namespace SmartVideo
+{
+    /// Fixed-size header at the beginning of every mask archive.
+    /// Frame records follow the header, back to back. The frame index is written last, at IndexOffset.
+    struct MaskArchiveHeader
+    {
+        static const unsigned int CurrentVersion = 1;
+
+        char Magic[4];                  // "SVMA"
+        unsigned int Version;
+        unsigned int Width, Height;
+        unsigned int FirstFrame;        // index of the first frame in the archive
+        unsigned int FrameCount;        // amount of index entries
+        unsigned long long IndexOffset; // offset of FrameCount MaskArchiveIndexEntry's
+    };
+
+    /// Location of one frame record in a mask archive.
+    struct MaskArchiveIndexEntry
+    {
+        unsigned long long Offset;      // 0, if the frame is missing
+        unsigned int Size;
+        unsigned int Reserved;
+    };
+
+    /// Writes the foreground and object masks of all frames of a clip into a single, run-length encoded file.
+    /// Every frame record holds two streams, both covering all pixels in row-major order:
+    /// 1. Foreground: alternating run lengths of background and foreground pixels (starting with background), as varints.
+    /// 2. Objects: runs of equal 8-bit BGR pixels, each stored as a varint length, followed by the three channels.
+    /// The archive is written to a temporary file that only replaces fname once it has been closed.
+    class MaskArchiveWriter
+    {
+        std::string fname;
+        std::ofstream file;
+        MaskArchiveHeader header;
+        std::vector<MaskArchiveIndexEntry> index;
+        std::vector<unsigned char> record;
+        unsigned long long offset;
+
+        /// Disallow copy ctor
+        MaskArchiveWriter(const MaskArchiveWriter&);
+        MaskArchiveWriter& operator=(const MaskArchiveWriter&);
+
+    public:
+        MaskArchiveWriter() : offset(0) {}
+
+        virtual ~MaskArchiveWriter()
+        {
+            Close();
+        }
+
+        /// Creates a new archive for the frames [firstFrame, firstFrame + frameCount).
+        /// Frame size is taken from the first frame that is written.
+        bool Create(const std::string& fname, unsigned int firstFrame, unsigned int frameCount);
+
+        /// Writes the index and moves the archive into place.
+        void Close();
+
+        bool IsOpen() const { return file.is_open(); }
+
+        /// Appends the masks of the given frame. 
+        /// foregroundMask is binary (CV_8U, any non-zero value is foreground), objectMask is CV_8UC3.
+        bool WriteFrame(unsigned int iFrame, const cv::Mat& foregroundMask, const cv::Mat& objectMask);
+    };
+
+    /// Random access to the frames of a mask archive. The archive is memory-mapped.
+    class MaskArchiveReader
+    {
+        Util::MappedFile file;
+        const MaskArchiveHeader* header;
+        const MaskArchiveIndexEntry* index;
+
+        /// Disallow copy ctor
+        MaskArchiveReader(const MaskArchiveReader&);
+        MaskArchiveReader& operator=(const MaskArchiveReader&);
+
+    public:
+        MaskArchiveReader() :
+            header(nullptr),
+            index(nullptr)
+        {
+        }
+
+        virtual ~MaskArchiveReader()
+        {
+            Close();
+        }
+
+        /// Maps the given archive. Returns false, if it does not exist, or has not been closed properly.
+        bool Open(const std::string& fname);
+
+        void Close();
+
+        bool IsOpen() const { return header != nullptr; }
+
+        int GetWidth() const { return header ? header->Width : 0; }
+        int GetHeight() const { return header ? header->Height : 0; }
+
+        /// Whether the given frame is stored in this archive.
+        bool HasFrame(unsigned int iFrame) const;
+
+        /// Decodes the masks of the given frame into foregroundMask (CV_8U, 0 or 255) and objectMask (CV_8UC3).
+        /// Returns false, if the frame is missing or corrupt.
+        bool ReadFrame(unsigned int iFrame, cv::Mat& foregroundMask, cv::Mat& objectMask) const;
+    };
+}
+
+#endif // MASKARCHIVE_H
@@ -1,8 +1,81 @@
 #include "matcher.h"
+#include "agglomerative.h"
 #include "hungarian.h"
+#include "assignment.h"
+#include "minCostFlow.h"
+
+#include <cmath>
+#include <limits>
 
 namespace Matcher {
 
+    namespace {
+        /// Objects bucketed by a grid of square cells, to find all objects near a point without testing every one.
+        class ObjectGrid {
+            const vector<ClusterInfo>& objs;
+            int cell,x0,y0,nx,ny;
+            vector<int> first;      // objects of cell c are index[first[c]..first[c+1])
+            vector<int> index;
+
+        public:
+            // cell<=0: no grid, every object is near every point
+            ObjectGrid(const vector<ClusterInfo>& objs,int cell):objs(objs),cell(cell),x0(0),y0(0),nx(0),ny(0) {
+                int n = objs.size();
+                if(cell<=0 || n==0) return;
+                int x1 = objs[0].x, y1 = objs[0].y;
+                x0 = x1; y0 = y1;
+                for(int i=1; i<n; i++) {
+                    x0 = min(x0,objs[i].x); x1 = max(x1,objs[i].x);
+                    y0 = min(y0,objs[i].y); y1 = max(y1,objs[i].y);
+                }
+                // a few objects per cell at most, whatever the gate is
+                while(static_cast<long long>((x1-x0)/this->cell+1)*((y1-y0)/this->cell+1) > 4LL*n+16) this->cell *= 2;
+                nx = (x1-x0)/this->cell+1;
+                ny = (y1-y0)/this->cell+1;
+
+                // counting sort by cell, which keeps the objects of every cell in increasing order
+                first.assign(nx*ny+1,0);
+                for(int i=0; i<n; i++) first[cellOf(objs[i].x,objs[i].y)+1]++;
+                for(int c=0; c<nx*ny; c++) first[c+1] += first[c];
+                index.resize(n);
+                vector<int> next(first.begin(),first.end()-1);
+                for(int i=0; i<n; i++) index[next[cellOf(objs[i].x,objs[i].y)]++] = i;
+            }
+
+            int cellOf(int x,int y) const {
+                return (x-x0)/cell*ny + (y-y0)/cell;
+            }
+
+            /// All objects whose centroid is at most sqrt(r2) from (x,y) (r2<0: all objects), in increasing order.
+            void findNear(int x,int y,double r2,vector<int>& near) const {
+                near.clear();
+                int n = objs.size();
+                if(r2<0 || cell<=0) {
+                    for(int i=0; i<n; i++) near.push_back(i);
+                    return;
+                }
+                if(n==0) return;
+                int r = static_cast<int>(ceil(sqrt(r2)));
+                int cx1 = max(0,static_cast<int>(floor(static_cast<double>(x-r-x0)/cell)));
+                int cx2 = min(nx-1,static_cast<int>(floor(static_cast<double>(x+r-x0)/cell)));
+                int cy1 = max(0,static_cast<int>(floor(static_cast<double>(y-r-y0)/cell)));
+                int cy2 = min(ny-1,static_cast<int>(floor(static_cast<double>(y+r-y0)/cell)));
+                for(int cx=cx1; cx<=cx2; cx++) {
+                    for(int cy=cy1; cy<=cy2; cy++) {
+                        int c = cx*ny+cy;
+                        for(int k=first[c]; k<first[c+1]; k++) {
+                            int i = index[k];
+                            double dx = x-objs[i].x, dy = y-objs[i].y;
+                            if(dx*dx+dy*dy <= r2) near.push_back(i);
+                        }
+                    }
+                }
+                // same order as testing every object
+                sort(near.begin(),near.end());
+            }
+        };
+    }
+
     int ClusterMatcher::lv(int x,int th) {
         return x*(maxOverlap+1)+th;
     }
@@ -21,47 +94,97 @@ namespace Matcher {
         int dis = (int)sqrt((lvInfo[a].x-rvInfo[b].x)*(lvInfo[a].x-rvInfo[b].x)+(lvInfo[a].y-rvInfo[b].y)*(lvInfo[a].y-rvInfo[b].y));
         return rateSizeChange*dsz+rateDisplacement*dis;
     }
-    int ClusterMatcher::solve(vector<pair<int,int>>& links) {
-        // construct
-        int lvn = ln*(maxOverlap+1);
-        int rvn = rn*(maxOverlap+1);
+    void ClusterMatcher::buildCostMatrix(Hungarian::HungarianMethod& hgm) {
+        const int stride = maxOverlap+1;
+        int lvn = ln*stride;
+        int rvn = rn*stride;
         int nn = lvn + rvn;
-        Hungarian::HungarianMethod hgm(nn,nn);
+
+        // every row is written once, already inverted (inf-cost), since we want minimum matching:
+        // overlap-overlap links are forbidden (cost inf), links to trash nodes cost nothing,
+        // except for main nodes, that pay for being abandoned
+        hgm.resize(nn,nn);
         for(int x=0; x<nn; x++) {
-            int xi = x/(maxOverlap+1);
-            bool xIsMain = x<lvn && x%(maxOverlap+1)==0;
-            bool xIsOverlap = x<lvn && x%(maxOverlap+1);
-            bool xIsTrash = x>=lvn;
-            for(int y=0; y<nn; y++) {
-                int yi = y/(maxOverlap+1);
-                bool yIsMain = y<rvn && y%(maxOverlap+1)==0;
-                bool yIsOverlap = y<rvn && y%(maxOverlap+1);
-                bool yIsTrash = y>=rvn;
-                int cost;
-                if(!xIsTrash&&!yIsTrash) {
-                    cost = nativeCost(xi,yi);
-                    if(xIsOverlap && yIsOverlap) cost = inf;
-                    else cost += costOverlap;
-                } else if(xIsTrash&&yIsTrash) {
-                    cost = 0;
-                } else {
-                    if(xIsOverlap || yIsOverlap) cost = 0;
-                    else if(xIsMain) cost = rateAbandon*lvInfo[xi].sz;
-                    else if(yIsMain) cost = rateAbandon*rvInfo[yi].sz;
-                    else assert(false); // should never happen
+            int* row = hgm.costRow(x);
+            int xi = x/stride;
+            if(x<lvn) {
+                bool xIsOverlap = x%stride!=0;
+                // costs between objects (the only part that needs sqrt) are computed for the main node, which comes first,
+                // and read back from its row by the overlap nodes
+                const int* mainRow = hgm.costRow(lv(xi,0));
+                for(int yi=0; yi<rn; yi++) {
+                    int* r = row + yi*stride;
+                    int link = xIsOverlap ? mainRow[yi*stride] : inf-(nativeCost(xi,yi)+costOverlap);
+                    assert(link>=0);
+                    r[0] = link;
+                    for(int k=1; k<stride; k++) r[k] = xIsOverlap ? 0 : link;
                 }
-                assert(cost<=inf);
-                hgm.setCost(x,y,cost);
+                fill(row+rvn, row+nn, xIsOverlap ? inf : inf-rateAbandon*lvInfo[xi].sz);
+            } else {
+                for(int yi=0; yi<rn; yi++) {
+                    int* r = row + yi*stride;
+                    r[0] = inf-rateAbandon*rvInfo[yi].sz;
+                    for(int k=1; k<stride; k++) r[k] = inf;
+                }
+                fill(row+rvn, row+nn, inf);
             }
         }
-        // invert the cost since we want minimum matching
-        for(int x=0; x<nn; x++) {
-            for(int y=0; y<nn; y++) {
-                hgm.setCost(x,y,inf-hgm.getCost(x,y));
+    }
+    long long ClusterMatcher::solve(vector<pair<int,int>>& links) {
+        Hungarian::HungarianMethod hgm;
+        return solve(links, hgm);
+    }
+    long long ClusterMatcher::solve(vector<pair<int,int>>& links, Hungarian::HungarianMethod& hgm) {
+        return solveDense(links, hgm, nullptr);
+    }
+    long long ClusterMatcher::solve(vector<pair<int,int>>& links, Hungarian::HungarianMethod& hgm, MatchDuals& duals) {
+        return solveDense(links, hgm, &duals);
+    }
+    bool ClusterMatcher::isWarmStartable(const MatchDuals& duals) {
+        // the left objects must be the right objects of the last matching (their positions may have been predicted since)
+        if(ln==0 || rn==0 || static_cast<int>(duals.objects.size())!=ln) return false;
+        for(int a=0; a<ln; a++) {
+            const ClusterInfo& o = duals.objects[a];
+            if(o.mx!=lvInfo[a].mx || o.my!=lvInfo[a].my || o.sz!=lvInfo[a].sz) return false;
+        }
+        return true;
+    }
+    long long ClusterMatcher::solveDense(vector<pair<int,int>>& links, Hungarian::HungarianMethod& hgm, MatchDuals* duals) {
+        const int stride = maxOverlap+1;
+        int lvn = ln*stride;
+        int rvn = rn*stride;
+        int nn = lvn + rvn;
+        buildCostMatrix(hgm);
+
+        bool warmStart = duals && isWarmStartable(*duals);
+        if(warmStart) {
+            // every object most likely continues the nearest object of the last frame, so its nodes start
+            // with the labels of that object's nodes (all trash nodes are alike, and share one label)
+            for(int b=0; b<rn; b++) {
+                int nearest = 0;
+                long long nearestDist2 = -1;
+                for(int a=0; a<ln; a++) {
+                    long long dx = lvInfo[a].x-rvInfo[b].x, dy = lvInfo[a].y-rvInfo[b].y;
+                    if(nearestDist2<0 || dx*dx+dy*dy<nearestDist2) {
+                        nearest = a;
+                        nearestDist2 = dx*dx+dy*dy;
+                    }
+                }
+                for(int k=0; k<stride; k++) hgm.setYLabel(rv(b,k), duals->nodeLabel[rv(nearest,k)]);
             }
+            for(int y=rvn; y<nn; y++) hgm.setYLabel(y, duals->trashLabel);
         }
+
         // hungarian
-        int mincost = hgm.maximumMatching();
+        long long mincost = hgm.maximumMatching(warmStart);
+
+        if(duals) {
+            duals->objects = rvInfo;
+            duals->nodeLabel.resize(rvn);
+            for(int y=0; y<rvn; y++) duals->nodeLabel[y] = hgm.getYLabel(y);
+            duals->trashLabel = 0;
+            for(int y=rvn; y<nn; y++) duals->trashLabel = y==rvn ? hgm.getYLabel(y) : min(duals->trashLabel, hgm.getYLabel(y));
+        }
         // return pair of relations
         //vector<pair<int,int>> ret;
         links.clear();
@@ -77,13 +200,171 @@ namespace Matcher {
         return mincost;
     }
 
+    long long ClusterMatcher::solveSparse(vector<pair<int,int>>& links, int gate, Assignment::SparseAssignment& sa) {
+        const int stride = maxOverlap+1;
+        int lvn = ln*stride;
+        int rvn = rn*stride;
+        int nn = lvn + rvn;
+
+        // only main nodes pay for being abandoned
+        sa.reset(lvn,rvn);
+        for(int a=0; a<ln; a++) sa.setXPenalty(lv(a,0),rateAbandon*lvInfo[a].sz);
+        for(int b=0; b<rn; b++) sa.setYPenalty(rv(b,0),rateAbandon*rvInfo[b].sz);
+
+        // links between gated objects (overlap-overlap is forbidden), found by a grid of the right objects
+        ObjectGrid grid(rvInfo, gate);
+        vector<int> near;
+        for(int a=0; a<ln; a++) {
+            // same gates as decompose()
+            double gate2 = gate>0 ? static_cast<double>(gate)*gate : -1;
+            if(gate>0 && lvInfo[a].gate2>=0) gate2 = min(gate2, lvInfo[a].gate2);
+            grid.findNear(lvInfo[a].x, lvInfo[a].y, gate2, near);
+            for(size_t k=0; k<near.size(); k++) {
+                int b = near[k];
+                int cost = nativeCost(a,b) + costOverlap;
+                assert(cost<=inf);
+                sa.addEdge(lv(a,0),rv(b,0),cost);
+                for(int k=1; k<stride; k++) {
+                    sa.addEdge(lv(a,0),rv(b,k),cost);
+                    sa.addEdge(lv(a,k),rv(b,0),cost);
+                }
+            }
+        }
+        long long mincost = sa.minimumAssignment();
+
+        links.clear();
+        for(int y=0; y<rvn; y++) {
+            int x = sa.getMatchY(y);
+            if( x==Assignment::nil ) continue;
+            links.push_back(make_pair(x/stride,y/stride));
+        }
+        // same scale as the (inverted) dense matching
+        return static_cast<long long>(nn)*inf - mincost;
+    }
+
+    long long ClusterMatcher::solveFlow(vector<pair<int,int>>& links, Flow::MinCostFlow& mcf) {
+        const int source = 0, sink = 1;
+        const int lmain = 2, lover = lmain+ln, rmain = lover+ln, rover = rmain+rn;
+        mcf.reset(rover+rn);
+
+        // arcs in topological order, so the initial potentials take a single pass
+        long long abandoned = 0;
+        for(int a=0; a<ln; a++) {
+            abandoned += rateAbandon*lvInfo[a].sz;
+            mcf.addArc(source,lmain+a,1,-rateAbandon*lvInfo[a].sz);
+            mcf.addArc(source,lover+a,maxOverlap,0);
+        }
+        // every link takes up the main node of at least one of its objects (overlap-overlap is forbidden)
+        int firstLink = mcf.getArcCount();
+        for(int a=0; a<ln; a++) {
+            for(int b=0; b<rn; b++) {
+                int cost = nativeCost(a,b) + costOverlap;
+                assert(cost<=inf);
+                mcf.addArc(lmain+a,rmain+b,1,cost);
+                mcf.addArc(lover+a,rmain+b,1,cost);
+                mcf.addArc(lmain+a,rover+b,1,cost);
+            }
+        }
+        for(int b=0; b<rn; b++) {
+            abandoned += rateAbandon*rvInfo[b].sz;
+            mcf.addArc(rmain+b,sink,1,-rateAbandon*rvInfo[b].sz);
+            mcf.addArc(rover+b,sink,maxOverlap,0);
+        }
+        long long mincost = abandoned + mcf.minimumCost(source,sink);
+
+        // links to the main node of an object come first, like in solve()
+        links.clear();
+        for(int b=0; b<rn; b++) {
+            for(int a=0; a<ln; a++) {
+                int arc = firstLink + 3*(a*rn+b);
+                if(mcf.getFlow(arc) || mcf.getFlow(arc+1)) links.push_back(make_pair(a,b));
+            }
+            for(int a=0; a<ln; a++) {
+                int arc = firstLink + 3*(a*rn+b);
+                if(mcf.getFlow(arc+2)) links.push_back(make_pair(a,b));
+            }
+        }
+        // same scale as the (inverted) dense matching
+        long long nn = static_cast<long long>(ln+rn)*(maxOverlap+1);
+        return nn*inf - mincost;
+    }
+
+    int ClusterMatcher::decompose(int gate, vector<int>& lGroup, vector<int>& rGroup) {
+        Agglomerative::DisjointSet<int> djs(ln+rn);
+        ObjectGrid grid(rvInfo, gate);
+        vector<int> near;
+        for(int a=0; a<ln; a++) {
+            double gate2 = gate>0 ? static_cast<double>(gate)*gate : -1;
+            if(gate>0 && lvInfo[a].gate2>=0) gate2 = min(gate2, lvInfo[a].gate2);
+            grid.findNear(lvInfo[a].x, lvInfo[a].y, gate2, near);
+            for(size_t k=0; k<near.size(); k++) {
+                int b = near[k];
+                if(nativeCost(a,b) + costOverlap > rateAbandon*(lvInfo[a].sz+rvInfo[b].sz)) continue;
+                djs.merge(a,ln+b);
+            }
+        }
+
+        // groups are numbered in order of their first object
+        vector<int> groupOf(ln+rn,-1);
+        int nGroups = 0;
+        lGroup.resize(ln);
+        rGroup.resize(rn);
+        for(int v=0; v<ln+rn; v++) {
+            int& g = groupOf[djs.getrep(v)];
+            if(g<0) g = nGroups++;
+            if(v<ln) lGroup[v] = g;
+            else rGroup[v-ln] = g;
+        }
+        return nGroups;
+    }
+
+    ClusterMatcher ClusterMatcher::subMatcher(const vector<int>& lIndex, const vector<int>& rIndex) const {
+        vector<ClusterInfo> lsub, rsub;
+        lsub.reserve(lIndex.size());
+        rsub.reserve(rIndex.size());
+        for(size_t i=0; i<lIndex.size(); i++) lsub.push_back(lvInfo[lIndex[i]]);
+        for(size_t i=0; i<rIndex.size(); i++) rsub.push_back(rvInfo[rIndex[i]]);
+        return ClusterMatcher(lsub, rsub, costOverlap, rateAbandon, rateDisplacement, rateSizeChange);
+    }
+
+    MatchDuals MatchDuals::select(const vector<int>& index, int n) const {
+        const int stride = maxOverlap+1;
+        MatchDuals sub;
+        if(static_cast<int>(objects.size())!=n) return sub;
+        sub.objects.reserve(index.size());
+        sub.nodeLabel.reserve(index.size()*stride);
+        for(size_t i=0; i<index.size(); i++) {
+            sub.objects.push_back(objects[index[i]]);
+            sub.nodeLabel.insert(sub.nodeLabel.end(), nodeLabel.begin()+index[i]*stride, nodeLabel.begin()+(index[i]+1)*stride);
+        }
+        // max, if nothing has been merged
+        sub.trashLabel = trashLabel==numeric_limits<int>::max() ? 0 : trashLabel;
+        return sub;
+    }
+    void MatchDuals::reset(int n) {
+        objects.assign(n, ClusterInfo(0,0,0));
+        nodeLabel.assign(n*(maxOverlap+1), 0);
+        trashLabel = numeric_limits<int>::max();
+    }
+    void MatchDuals::merge(const MatchDuals& part, const vector<int>& index) {
+        const int stride = maxOverlap+1;
+        for(size_t i=0; i<index.size(); i++) {
+            objects[index[i]] = part.objects[i];
+            copy(part.nodeLabel.begin()+i*stride, part.nodeLabel.begin()+(i+1)*stride, nodeLabel.begin()+index[i]*stride);
+        }
+        trashLabel = min(trashLabel, part.trashLabel);
+    }
+
     vector<ClusterInfo> obj2cinfo(const vector<SmartVideo::ObjectProfile>& objs) {
         vector<ClusterInfo> cinfo;
-        cinfo.reserve(objs.size());
-        for(auto obj: objs) {
+        obj2cinfo(objs, cinfo);
+        return cinfo;
+    }
+    void obj2cinfo(const vector<SmartVideo::ObjectProfile>& objs, vector<ClusterInfo>& cinfo) {
+        cinfo.clear();
+        for(auto& obj: objs) {
             //cinfo.push_back(obj);
             cinfo.push_back(ClusterInfo(obj.x,obj.y,obj.area));
         }
-        return cinfo;
     }
 }
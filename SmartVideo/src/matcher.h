@@ -7,6 +7,21 @@
 
 using namespace std;
 
+namespace Hungarian
+{
+    class HungarianMethod;
+}
+
+namespace Assignment
+{
+    class SparseAssignment;
+}
+
+namespace Flow
+{
+    class MinCostFlow;
+}
+
 /*
  * COSTS:
  * + kill a node (disappearance/creation) = +20*sz
@@ -32,10 +47,33 @@ namespace Matcher
     struct ClusterInfo {
         int x,y;
         int sz;
-        ClusterInfo(int x,int y,int sz):x(x),y(y),sz(sz) {}
+        double gate2;   // squared distance that links from this object may span (in sparse mode), < 0 for the default gate
+        int mx,my;      // measured centroid, which stays the same when x,y are replaced by a prediction
+        ClusterInfo(int x,int y,int sz,double gate2=-1):x(x),y(y),sz(sz),gate2(gate2),mx(x),my(y) {}
         //ClusterInfo(SmartVideo::ObjectProfile obj):x(obj.x),y(obj.y),sz(obj.area) {}
     };
 
+    /// Labels of the last dense matching, to warm-start the matching of the next frame
+    /// (whose left objects are the right objects of the last one).
+    struct MatchDuals {
+        vector<ClusterInfo> objects;    // right objects of the last matching
+        vector<int> nodeLabel;          // label of every main and overlap node of these objects
+        int trashLabel;                 // lowest label of all trash nodes (which are interchangeable)
+        MatchDuals():trashLabel(0) {}
+        void clear() {
+            objects.clear();
+            nodeLabel.clear();
+            trashLabel = 0;
+        }
+        // labels of the given objects only (e.g. the left objects of one group, see ClusterMatcher::subMatcher),
+        // or none, if there are no labels of n objects
+        MatchDuals select(const vector<int>& index, int n) const;
+        // makes room for the labels of n objects, to be put together by merge()
+        void reset(int n);
+        // puts the labels of a matching of some objects (e.g. the right objects of one group) at their index
+        void merge(const MatchDuals& part, const vector<int>& index);
+    };
+
     class ClusterMatcher {
 
         int ln,rn;
@@ -50,6 +88,9 @@ namespace Matcher
         int rv(int x,int th);
         int rtrash(int x);
         int nativeCost(int a,int b);
+        void buildCostMatrix(Hungarian::HungarianMethod& hgm);
+        bool isWarmStartable(const MatchDuals& duals);
+        long long solveDense(vector<pair<int,int>> &, Hungarian::HungarianMethod& hgm, MatchDuals* duals);
 
     public:
         ClusterMatcher(vector<ClusterInfo> lvInfo,
@@ -64,10 +105,38 @@ namespace Matcher
             ln = lvInfo.size();
             rn = rvInfo.size();
         }
-        int solve(vector<pair<int,int>> &);
+        // matches other objects with the same costs, re-using the buffers of this matcher
+        void setObjects(const vector<ClusterInfo>& lvInfo, const vector<ClusterInfo>& rvInfo) {
+            this->lvInfo.assign(lvInfo.begin(), lvInfo.end());
+            this->rvInfo.assign(rvInfo.begin(), rvInfo.end());
+            ln = lvInfo.size();
+            rn = rvInfo.size();
+        }
+        long long solve(vector<pair<int,int>> &);
+        // same, but re-uses the buffers of the given solver (keep one per thread)
+        long long solve(vector<pair<int,int>> &, Hungarian::HungarianMethod& hgm);
+        // same, but warm-started from the labels of the last frame (if its right objects are our left objects), 
+        // and leaves its own labels for the next frame; the result is the same as without warm start
+        long long solve(vector<pair<int,int>> &, Hungarian::HungarianMethod& hgm, MatchDuals& duals);
+        // same costs, but only objects at most gate pixels apart (or at most their own gate, if smaller; no limit if gate<=0) can be linked,
+        // and the graph stays sparse:
+        // abandoning a node is its penalty instead of a link to a trash node
+        long long solveSparse(vector<pair<int,int>> &, int gate, Assignment::SparseAssignment& sa);
+        // same costs and result as solve(), but as a min-cost flow on two nodes per object instead of maxOverlap+1 nodes and the trash nodes:
+        // a main node (capacity 1, whose use saves the abandon cost) and an overlap node (capacity maxOverlap), since overlap nodes are alike
+        long long solveFlow(vector<pair<int,int>> &, Flow::MinCostFlow& mcf);
+
+        // splits the objects into groups that can be matched independently: objects are only linked if they are at most gate pixels
+        // apart (or at most their own gate, if smaller; no limit if gate<=0), and never if the link costs more than abandoning both
+        // (removing such a link always lowers the cost). Returns the amount of groups, and the group of every left and right object.
+        int decompose(int gate, vector<int>& lGroup, vector<int>& rGroup);
+        // matcher of the given left and right objects (e.g. one group), with the same costs; its object i is lIndex[i] (rIndex[i]) in this matcher
+        ClusterMatcher subMatcher(const vector<int>& lIndex, const vector<int>& rIndex) const;
     };
 
     vector<ClusterInfo> obj2cinfo(const vector<SmartVideo::ObjectProfile>& objs);
+    // same, but re-uses the given vector
+    void obj2cinfo(const vector<SmartVideo::ObjectProfile>& objs, vector<ClusterInfo>& cinfo);
 
 }
 
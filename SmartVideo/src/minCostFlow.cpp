@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <climits>
+#include <functional>
+#include <queue>
+
+#include "minCostFlow.h"
+
+using namespace std;
+
+namespace Flow {
+
+    namespace {
+        const long long unreached=LLONG_MAX;
+    }
+
+    void MinCostFlow::reset(int n) {
+        this->n=n;
+        arcs.clear();
+    }
+
+    void MinCostFlow::buildGraph() {
+        int nResidual=2*arcs.size();
+        arcStart.assign(n+1,0);
+        for(int r=0;r<nResidual;r++) arcStart[tail(r)+1]++;
+        for(int v=0;v<n;v++) arcStart[v+1]+=arcStart[v];
+
+        vector<int>& fill=prevArc;      // not needed until augment()
+        fill.assign(arcStart.begin(),arcStart.end()-1);
+        residualArc.resize(nResidual);
+        for(int r=0;r<nResidual;r++) residualArc[fill[tail(r)]++]=r;
+
+        flow.assign(arcs.size(),0);
+    }
+
+    bool MinCostFlow::initPotentials(int source) {
+        // Bellman-Ford on the arcs (no flow yet), in the order they were added
+        dist.assign(n,unreached);
+        dist[source]=0;
+        for(int pass=0;pass<n;pass++) {
+            bool isChanged=false;
+            for(size_t k=0;k<arcs.size();k++) {
+                const Arc& a=arcs[k];
+                if(a.capacity<=0 || dist[a.from]==unreached) continue;
+                long long d=dist[a.from]+a.cost;
+                if(d<dist[a.to]) {
+                    dist[a.to]=d;
+                    isChanged=true;
+                }
+            }
+            if(!isChanged) break;
+            if(pass==n-1) return false;     // negative cycle
+        }
+
+        // nodes that cannot be reached now will never be reached
+        potential.resize(n);
+        for(int v=0;v<n;v++) potential[v]=dist[v]==unreached ? 0 : dist[v];
+        return true;
+    }
+
+    bool MinCostFlow::augment(int source,int sink,long long& cost) {
+        dist.assign(n,unreached);
+        done.assign(n,0);
+        prevArc.assign(n,-1);
+
+        typedef pair<long long,int> Label;
+        priority_queue<Label,vector<Label>,greater<Label>> queue;
+        dist[source]=0;
+        queue.push(Label(0,source));
+
+        // Dijkstra on reduced costs (cost + potential(tail) - potential(head) >= 0)
+        while(!queue.empty()) {
+            Label top=queue.top();
+            queue.pop();
+            int u=top.second;
+            if(done[u]) continue;
+            done[u]=1;
+            if(u==sink) break;
+
+            for(int i=arcStart[u];i<arcStart[u+1];i++) {
+                int r=residualArc[i];
+                if(residualCapacity(r)<=0) continue;
+                int v=head(r);
+                long long d=dist[u]+residualCost(r)+potential[u]-potential[v];
+                if(d<dist[v]) {
+                    dist[v]=d;
+                    prevArc[v]=r;
+                    queue.push(Label(d,v));
+                }
+            }
+        }
+        if(!done[sink]) return false;
+
+        // the path is only worth taking if it lowers the total cost
+        long long pathCost=dist[sink]-potential[source]+potential[sink];
+        if(pathCost>=0) return false;
+
+        // keep reduced costs non-negative (and zero along the path)
+        long long dsink=dist[sink];
+        for(int v=0;v<n;v++) potential[v]+=min(dist[v],dsink);
+
+        int amount=INT_MAX;
+        for(int v=sink;v!=source;v=tail(prevArc[v])) amount=min(amount,residualCapacity(prevArc[v]));
+        for(int v=sink;v!=source;v=tail(prevArc[v])) {
+            int r=prevArc[v];
+            flow[r>>1]+= r&1 ? -amount : amount;
+        }
+        cost+=pathCost*amount;
+        return true;
+    }
+
+    long long MinCostFlow::minimumCost(int source,int sink) {
+        buildGraph();
+        long long cost=0;
+        if(source==sink || !initPotentials(source)) return cost;
+        while(augment(source,sink,cost));
+        return cost;
+    }
+
+}
@@ -0,0 +1,73 @@
+#ifndef MINCOSTFLOW_H
+#define MINCOSTFLOW_H
+
+#include <vector>
+
+namespace Flow {
+
+    /// Minimum cost flow from a source to a sink, where the amount of flow is free: flow is only sent
+    /// as long as it lowers the total cost. Arc costs may be negative, as long as there is no negative cycle.
+    ///
+    /// Solved by successive shortest paths: Bellman-Ford gives the initial potentials (one pass, if arcs
+    /// were added in topological order), then every path is found by Dijkstra on reduced costs, and carries
+    /// as much flow as its narrowest arc allows. Path costs only grow, so solving stops at the first path
+    /// that does not cost less than nothing.
+    /// Buffers keep their capacity, so one instance can solve many problems without reallocating.
+    class MinCostFlow {
+
+        struct Arc {
+            int from,to,capacity,cost;
+            Arc(int from,int to,int capacity,int cost):from(from),to(to),capacity(capacity),cost(cost) {}
+        };
+
+        int n;
+        std::vector<Arc> arcs;
+
+        // residual graph (CSR): arc 2k is arc k, arc 2k+1 its reverse
+        std::vector<int> arcStart;
+        std::vector<int> residualArc;           // residual arcs, grouped by tail
+        std::vector<int> flow;                  // of arc k
+
+        std::vector<long long> potential;
+        std::vector<long long> dist;
+        std::vector<int> prevArc;               // residual arc that reached the node on the shortest path
+        std::vector<char> done;
+
+        void buildGraph();
+        bool initPotentials(int source);
+        bool augment(int source,int sink,long long& cost);
+
+        int tail(int r) const { return r&1 ? arcs[r>>1].to : arcs[r>>1].from; }
+        int head(int r) const { return r&1 ? arcs[r>>1].from : arcs[r>>1].to; }
+        int residualCapacity(int r) const { return r&1 ? flow[r>>1] : arcs[r>>1].capacity-flow[r>>1]; }
+        long long residualCost(int r) const { return r&1 ? -arcs[r>>1].cost : arcs[r>>1].cost; }
+
+        /// Disallow copy ctor
+        MinCostFlow(const MinCostFlow&);
+        MinCostFlow& operator=(const MinCostFlow&);
+
+    public:
+        MinCostFlow(int n = 0) {
+            reset(n);
+        }
+
+        /// Starts a new problem with the given amount of nodes, and without arcs.
+        void reset(int n);
+
+        /// Adds an arc, and returns its index.
+        int addArc(int from,int to,int capacity,int cost) {
+            arcs.push_back(Arc(from,to,capacity,cost));
+            return static_cast<int>(arcs.size())-1;
+        }
+
+        int getNodeCount() const { return n; }
+        int getArcCount() const { return arcs.size(); }
+        int getFlow(int arc) const { return flow[arc]; }
+
+        /// Returns the minimum total cost (0, if no flow pays off).
+        long long minimumCost(int source,int sink);
+    };
+
+}
+
+#endif // MINCOSTFLOW_H
@@ -25,6 +25,13 @@ namespace SmartVideo {
         return Matcher::ClusterInfo(x,y,area);
     }*/
 
+    void ObjectProfile::reset() {
+        colorProfile.clear();
+        x=y=area=0;
+        x1=y1=maxreso;
+        x2=y2=-1;
+    }
+
     void ObjectProfile::addPixel(int x,int y) {
             this->x+=x;
             this->y+=y;
@@ -34,11 +41,33 @@ namespace SmartVideo {
             y2=max(y2,y);
             area++;
         }
+        void ObjectProfile::addRun(int x,int yBegin,int yEnd) {
+            int len = yEnd-yBegin;
+            if(len <= 0) return;
+            this->x+=x*len;
+            this->y+=(yBegin+yEnd-1)*len/2;
+            x1=min(x1,x);
+            x2=max(x2,x);
+            y1=min(y1,yBegin);
+            y2=max(y2,yEnd-1);
+            area+=len;
+        }
         void ObjectProfile::statistics() {
             if(!area) return;
             x/=area;
             y/=area;
         }
+        void ObjectProfile::scale(int factor) {
+            if(factor<=1 || !area) return;
+            // every pixel covers a factor x factor block
+            x=x*factor+factor/2;
+            y=y*factor+factor/2;
+            x1*=factor;
+            y1*=factor;
+            x2=x2*factor+factor-1;
+            y2=y2*factor+factor-1;
+            area*=factor*factor;
+        }
 
     ColorProfile ObjectProfile::avgColor() { return mixture(colorProfile); }
 
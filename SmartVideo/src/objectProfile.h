@@ -46,8 +46,11 @@ namespace SmartVideo {
             x1=y1=maxreso;
             x2=y2=-1;
         }
+        void reset(); // empty again, but keeps the buffer of colorProfile
         void addPixel(int x,int y);
+        void addRun(int x,int yBegin,int yEnd); // all pixels (x,y) with y in [yBegin,yEnd)
         void statistics();
+        void scale(int factor); // from a downsampled frame to full resolution (after statistics())
         void adoptColor(ColorProfile cp);
         ColorProfile avgColor();
         //operator Matcher::ClusterInfo();
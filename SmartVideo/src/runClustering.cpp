@@ -0,0 +1,80 @@
+#include "runClustering.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Agglomerative {
+
+    void RunLengthClustering::encodeRuns(const unsigned char* mask, int rows, int cols, size_t step) {
+        runs.clear();
+        rowStart.resize(rows + 1);
+        fgArea = 0;
+        for(int r=0; r<rows; r++) {
+            rowStart[r] = runs.size();
+            const unsigned char* row = mask + r * step;
+            int c = 0;
+            while(c < cols) {
+                while(c < cols && !row[c]) c++;
+                if(c == cols) break;
+                int begin = c;
+                while(c < cols && row[c]) c++;
+                runs.push_back(Run(r,begin,c));
+                fgArea += c-begin;
+            }
+        }
+        rowStart[rows] = runs.size();
+    }
+
+    void RunLengthClustering::joinRows(int r, int q, int gap) {
+        // runs of both rows are sorted, so sweep over both at once
+        int i = rowStart[q], iEnd = rowStart[q+1];
+        int j = rowStart[r], jEnd = rowStart[r+1];
+        while(i < iEnd && j < jEnd) {
+            const Run& a = runs[i];
+            const Run& b = runs[j];
+            if(a.end-1+gap < b.begin) i++;
+            else if(b.end-1+gap < a.begin) j++;
+            else {
+                djs.merge(i,j);
+                if(a.end < b.end) i++;
+                else j++;
+            }
+        }
+    }
+
+    void RunLengthClustering::cluster(const unsigned char* mask, int rows, int cols, size_t step, double dthreshold, int cthreshold) {
+        encodeRuns(mask, rows, cols, step);
+        int n = runs.size();
+        djs.reset(n);
+
+        // pixels are joined, if they are less than dthreshold apart in x and in y
+        int gap = static_cast<int>(ceil(dthreshold)) - 1;
+        if(gap >= 0) {
+            for(int r=0; r<rows; r++) {
+                // neighbours in the same row
+                for(int j=rowStart[r]+1; j<rowStart[r+1]; j++) {
+                    if(runs[j].begin - runs[j-1].end + 1 <= gap) djs.merge(j-1,j);
+                }
+                // runs of previous rows
+                for(int q=max(r-gap,0); q<r; q++) {
+                    joinRows(r, q, gap);
+                }
+            }
+        }
+
+        // drop small components, and assign ids
+        compSize.assign(n,0);
+        for(int i=0; i<n; i++) {
+            compSize[djs.getrep(i)] += runs[i].length();
+        }
+        idmap.assign(n,-1);
+        nClusters = 0;
+        for(int i=0; i<n; i++) {
+            int h = djs.getrep(i);
+            if(compSize[h] < cthreshold) continue;
+            if(idmap[h] < 0) idmap[h] = nClusters++;
+            runs[i].id = idmap[h];
+        }
+    }
+
+}
@@ -0,0 +1,57 @@
+#ifndef RUNCLUSTERING_H
+#define RUNCLUSTERING_H
+
+#include "agglomerative.h"
+
+#include <vector>
+
+namespace Agglomerative
+{
+    /// Horizontal run of foreground pixels [begin, end) in one row of a mask.
+    struct Run {
+        int row, begin, end;
+        int id;         // cluster id, or -1 if the run's component is too small
+        Run(int row,int begin,int end):row(row),begin(begin),end(end),id(-1) {}
+        int length() const { return end-begin; }
+    };
+
+    /// Clusters the foreground pixels of a binary mask, without looking at single pixels:
+    /// Every row is encoded as runs, and runs are joined, if any two of their pixels are 
+    /// less than dthreshold apart in both x and y (Chebyshev distance). 
+    /// That is the same as dilating the mask by a square of size dthreshold and labeling 
+    /// connected components, and a superset of the (Euclidean) grouping of AgglomerativeClustering:
+    /// diagonal neighbours up to sqrt(2)*dthreshold apart are also joined.
+    /// Cluster ids are assigned in row-major order of first appearance, like AgglomerativeClustering
+    /// does for pixels from findNonZero.
+    class RunLengthClustering
+    {
+        vector<Run> runs;
+        vector<int> rowStart;       // index of the first run of every row (plus end)
+        DisjointSet<int> djs;
+        vector<int> compSize;
+        vector<int> idmap;
+        int nClusters;
+        int fgArea;
+
+        void encodeRuns(const unsigned char* mask, int rows, int cols, size_t step);
+        void joinRows(int r, int q, int gap);
+
+    public:
+        RunLengthClustering():nClusters(0),fgArea(0) {}
+
+        /// Clusters the non-zero pixels of the given 8-bit mask (rows x cols, step bytes per row).
+        /// Components with less than cthreshold pixels are dropped.
+        void cluster(const unsigned char* mask, int rows, int cols, size_t step, double dthreshold, int cthreshold);
+
+        /// All runs of the last mask, in row-major order.
+        const vector<Run>& getRuns() const { return runs; }
+
+        /// Amount of clusters found in the last mask.
+        int getClusterCount() const { return nClusters; }
+
+        /// Amount of foreground pixels of the last mask (including dropped components).
+        int getForegroundArea() const { return fgArea; }
+    };
+}
+
+#endif // RUNCLUSTERING_H
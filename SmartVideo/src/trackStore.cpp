@@ -0,0 +1,273 @@
+#include "trackStore.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <iostream>
+
+using namespace std;
+
+namespace SmartVideo
+{
+    namespace
+    {
+        unsigned short ToCoordinate(int value)
+        {
+            return static_cast<unsigned short>(min(max(value, 0), 0xffff));
+        }
+
+        bool IsBefore(const TrackRecord& record, unsigned int id)
+        {
+            return record.Id < id;
+        }
+
+        bool HasLowerId(const TrackRecord& a, const TrackRecord& b)
+        {
+            return a.Id < b.Id;
+        }
+    }
+
+
+    bool TrackStore::Create(const std::string& fname, unsigned int firstFrame, unsigned int frameCount)
+    {
+        Close();
+        Clear();
+
+        this->fname = fname;
+        file.open(fname + ".tmp", ofstream::out | ofstream::binary | ofstream::trunc);
+        if (!file) return false;
+
+        memcpy(header.Magic, "SVTR", 4);
+        header.Version = TrackFileHeader::CurrentVersion;
+        header.FirstFrame = firstFrame;
+        header.FrameCount = frameCount;
+        header.RecordCount = 0;
+        header.TrackCount = 0;
+        header.FrameIndexOffset = header.TrackIndexOffset = 0;
+
+        // filled up to the next written frame, so skipped frames have no records
+        frameIndex.clear();
+        frameIndex.reserve(frameCount + 1);
+        trackIndex.clear();
+
+        // header is written again on Close()
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        return !!file;
+    }
+
+    void TrackStore::Close()
+    {
+        if (!file.is_open()) return;
+
+        frameIndex.resize(header.FrameCount + 1, header.RecordCount);
+        header.TrackCount = static_cast<unsigned int>(trackIndex.size());
+        header.FrameIndexOffset = sizeof(header) + static_cast<unsigned long long>(header.RecordCount) * sizeof(TrackRecord);
+        header.TrackIndexOffset = header.FrameIndexOffset + frameIndex.size() * sizeof(unsigned int);
+
+        file.write(reinterpret_cast<const char*>(&frameIndex[0]), frameIndex.size() * sizeof(unsigned int));
+        if (!trackIndex.empty())
+        {
+            file.write(reinterpret_cast<const char*>(&trackIndex[0]), trackIndex.size() * sizeof(TrackIndexEntry));
+        }
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        bool isWritten = !!file;
+        file.close();
+
+        string tmpName = fname + ".tmp";
+        if (!isWritten || !Util::RenameFile(tmpName, fname))
+        {
+            cerr << "WARNING: Unable to write track file " << fname << endl;
+            remove(tmpName.c_str());
+        }
+        frameIndex.clear();
+        trackIndex.clear();
+    }
+
+    void TrackStore::Clear()
+    {
+        tracks.resize(0);
+        next.resize(0);
+        motion.Clear();
+        nextId = 0;
+    }
+
+    void TrackStore::Update(unsigned int iFrame, const std::vector<std::pair<int, int>>& links, const std::vector<ObjectProfile>& objects)
+    {
+        int n = static_cast<int>(objects.size());
+        int nPrev = tracks.size();
+
+        // first link of every object, and the largest object of every continued track
+        trackOf.assign(n, -1);
+        for (size_t k = 0; k < links.size(); ++k)
+        {
+            int i = links[k].first, j = links[k].second;
+            if (i < nPrev && trackOf[j] < 0) trackOf[j] = i;
+        }
+        heir.assign(nPrev, -1);
+        for (int j = 0; j < n; ++j)
+        {
+            int i = trackOf[j];
+            if (i >= 0 && (heir[i] < 0 || objects[j].area > objects[heir[i]].area)) heir[i] = j;
+        }
+
+        next.resize(n);
+        records.resize(n);
+        motion.BeginUpdate(n);
+        for (int j = 0; j < n; ++j)
+        {
+            const ObjectProfile& obj = objects[j];
+            int i = trackOf[j];
+            if (i >= 0 && heir[i] == j)
+            {
+                next.id[j] = tracks.id[i];
+                next.firstFrame[j] = tracks.firstFrame[i];
+                next.length[j] = tracks.length[i] + 1;
+                motion.ContinueTrack(j, i, static_cast<float>(obj.x), static_cast<float>(obj.y));
+            }
+            else
+            {
+                next.id[j] = nextId++;
+                next.firstFrame[j] = iFrame;
+                next.length[j] = 1;
+                motion.StartTrack(j, static_cast<float>(obj.x), static_cast<float>(obj.y));
+            }
+
+            TrackRecord& record = records[j];
+            record.Id = next.id[j];
+            record.X1 = ToCoordinate(obj.x1);
+            record.Y1 = ToCoordinate(obj.y1);
+            record.X2 = ToCoordinate(obj.x2);
+            record.Y2 = ToCoordinate(obj.y2);
+            record.X = ToCoordinate(obj.x);
+            record.Y = ToCoordinate(obj.y);
+            record.Area = static_cast<unsigned int>(max(obj.area, 0));
+        }
+
+        // swap keeps the capacity of both sets
+        std::swap(tracks.id, next.id);
+        std::swap(tracks.firstFrame, next.firstFrame);
+        std::swap(tracks.length, next.length);
+        motion.EndUpdate();
+
+        if (file.is_open() && !WriteFrame(iFrame))
+        {
+            cerr << "WARNING: Unable to write tracks of frame " << iFrame << " to " << fname << endl;
+        }
+    }
+
+    bool TrackStore::WriteFrame(unsigned int iFrame)
+    {
+        // frames can only be appended
+        if (iFrame < header.FirstFrame || iFrame - header.FirstFrame >= header.FrameCount ||
+            iFrame - header.FirstFrame < frameIndex.size())
+        {
+            return false;
+        }
+        frameIndex.resize(iFrame - header.FirstFrame + 1, header.RecordCount);
+
+        for (int j = 0; j < tracks.size(); ++j)
+        {
+            unsigned int id = tracks.id[j];
+            if (id >= trackIndex.size()) trackIndex.resize(id + 1);
+            TrackIndexEntry& entry = trackIndex[id];
+            entry.FirstFrame = tracks.firstFrame[j];
+            entry.LastFrame = iFrame;
+            entry.Length = tracks.length[j];
+        }
+
+        // readers find a track's record by binary search
+        sort(records.begin(), records.end(), HasLowerId);
+        if (!records.empty())
+        {
+            file.write(reinterpret_cast<const char*>(&records[0]), records.size() * sizeof(TrackRecord));
+        }
+        header.RecordCount += static_cast<unsigned int>(records.size());
+        return !!file;
+    }
+
+
+    bool TrackFileReader::Open(const std::string& fname)
+    {
+        Close();
+
+        if (!file.OpenRead(fname) || file.GetSize() < sizeof(TrackFileHeader))
+        {
+            file.Close();
+            return false;
+        }
+
+        const TrackFileHeader* h = reinterpret_cast<const TrackFileHeader*>(file.GetData());
+        bool isUsable =
+            memcmp(h->Magic, "SVTR", 4) == 0 &&
+            h->Version == TrackFileHeader::CurrentVersion &&
+            h->FrameIndexOffset == sizeof(TrackFileHeader) + static_cast<unsigned long long>(h->RecordCount) * sizeof(TrackRecord) &&
+            h->TrackIndexOffset == h->FrameIndexOffset + (h->FrameCount + 1ull) * sizeof(unsigned int) &&
+            h->TrackIndexOffset + static_cast<unsigned long long>(h->TrackCount) * sizeof(TrackIndexEntry) <= file.GetSize();
+        if (!isUsable)
+        {
+            file.Close();
+            return false;
+        }
+
+        header = h;
+        records = reinterpret_cast<const TrackRecord*>(file.GetData() + sizeof(TrackFileHeader));
+        frameIndex = reinterpret_cast<const unsigned int*>(file.GetData() + h->FrameIndexOffset);
+        trackIndex = reinterpret_cast<const TrackIndexEntry*>(file.GetData() + h->TrackIndexOffset);
+        return true;
+    }
+
+    void TrackFileReader::Close()
+    {
+        file.Close();
+        header = nullptr;
+        records = nullptr;
+        frameIndex = nullptr;
+        trackIndex = nullptr;
+    }
+
+    int TrackFileReader::GetFrame(unsigned int iFrame, const TrackRecord*& frameRecords) const
+    {
+        frameRecords = nullptr;
+        if (!header || iFrame < header->FirstFrame || iFrame - header->FirstFrame >= header->FrameCount) return 0;
+
+        unsigned int begin = frameIndex[iFrame - header->FirstFrame];
+        unsigned int end = frameIndex[iFrame - header->FirstFrame + 1];
+        if (begin > end || end > header->RecordCount) return 0;
+
+        frameRecords = records + begin;
+        return static_cast<int>(end - begin);
+    }
+
+    const TrackRecord* TrackFileReader::FindRecord(unsigned int iFrame, unsigned int id) const
+    {
+        const TrackRecord* frameRecords;
+        int n = GetFrame(iFrame, frameRecords);
+        const TrackRecord* record = lower_bound(frameRecords, frameRecords + n, id, IsBefore);
+        return record != frameRecords + n && record->Id == id ? record : nullptr;
+    }
+
+    const TrackIndexEntry* TrackFileReader::GetTrack(unsigned int id) const
+    {
+        return header && id < header->TrackCount ? trackIndex + id : nullptr;
+    }
+
+    bool TrackFileReader::ReadTrack(unsigned int id, std::vector<unsigned int>& frames, std::vector<TrackRecord>& trackRecords) const
+    {
+        frames.clear();
+        trackRecords.clear();
+        const TrackIndexEntry* track = GetTrack(id);
+        if (!track) return false;
+
+        for (unsigned long long iFrame = track->FirstFrame; iFrame <= track->LastFrame; ++iFrame)
+        {
+            const TrackRecord* record = FindRecord(static_cast<unsigned int>(iFrame), id);
+            if (record)
+            {
+                frames.push_back(static_cast<unsigned int>(iFrame));
+                trackRecords.push_back(*record);
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,188 @@
+#ifndef TRACKSTORE_H
+#define TRACKSTORE_H
+
+#include "FileUtil.h"
+#include "objectProfile.h"
+#include "kalman.h"
+
+#include <fstream>
+#include <utility>
+#include <vector>
+
+namespace SmartVideo
+{
+    /// Fixed-size header at the beginning of every track file.
+    /// Track records of all frames follow the header, back to back, in frame order.
+    /// Both indices are written last, at their offsets.
+    struct TrackFileHeader
+    {
+        static const unsigned int CurrentVersion = 1;
+
+        char Magic[4];                  // "SVTR"
+        unsigned int Version;
+        unsigned int FirstFrame;        // index of the first frame in the file
+        unsigned int FrameCount;        // amount of frames; the frame index has FrameCount + 1 entries
+        unsigned int RecordCount;       // amount of TrackRecord's
+        unsigned int TrackCount;        // amount of TrackIndexEntry's, track IDs are [0, TrackCount)
+        unsigned long long FrameIndexOffset;  // offset of FrameCount + 1 record numbers: records of frame i are [index[i], index[i + 1])
+        unsigned long long TrackIndexOffset;  // offset of TrackCount TrackIndexEntry's
+    };
+
+    /// One object of one frame. Coordinates are (row, column), like in ObjectProfile.
+    struct TrackRecord
+    {
+        unsigned int Id;
+        unsigned short X1, Y1, X2, Y2;  // bounding box (inclusive)
+        unsigned short X, Y;            // centroid
+        unsigned int Area;              // amount of pixels
+    };
+
+    /// Life time of one track.
+    struct TrackIndexEntry
+    {
+        unsigned int FirstFrame;
+        unsigned int LastFrame;
+        unsigned int Length;            // amount of frames that the track has an object in
+    };
+
+    /// Assigns stable IDs to the objects of consecutive frames, and streams their records into a track file.
+    ///
+    /// Matching links (previous object, current object) decide which objects continue which track:
+    /// every object continues the track of the first object it is linked to. If several objects continue the
+    /// same track (the object split), the largest one keeps its ID, and the others start new tracks.
+    /// Every track also carries a Kalman filter of its motion, which follows the same rule: the object that keeps
+    /// the ID continues the filter, and all others start a new one.
+    /// Per-track state is kept as structure of arrays, indexed by the objects of the last frame.
+    ///
+    /// The file is written to a temporary file that only replaces fname once it has been closed.
+    class TrackStore
+    {
+        struct TrackArrays
+        {
+            std::vector<unsigned int> id;
+            std::vector<unsigned int> firstFrame;
+            std::vector<unsigned int> length;
+
+            void resize(int n)
+            {
+                id.resize(n);
+                firstFrame.resize(n);
+                length.resize(n);
+            }
+            int size() const { return static_cast<int>(id.size()); }
+        };
+
+        TrackArrays tracks, next;
+        Tracking::KalmanTracks motion;
+        unsigned int nextId;
+        std::vector<int> trackOf, heir;
+
+        std::string fname;
+        std::ofstream file;
+        TrackFileHeader header;
+        std::vector<unsigned int> frameIndex;
+        std::vector<TrackIndexEntry> trackIndex;
+        std::vector<TrackRecord> records;
+
+        /// Disallow copy ctor
+        TrackStore(const TrackStore&);
+        TrackStore& operator=(const TrackStore&);
+
+        bool WriteFrame(unsigned int iFrame);
+
+    public:
+        /// Noise of the motion filters (see Tracking::KalmanTracks).
+        TrackStore(float processNoise = 4.0f, float measurementNoise = 25.0f) :
+            motion(processNoise, measurementNoise),
+            nextId(0)
+        {
+        }
+
+        virtual ~TrackStore()
+        {
+            Close();
+        }
+
+        /// Creates a new track file for the frames [firstFrame, firstFrame + frameCount), and drops all tracks.
+        bool Create(const std::string& fname, unsigned int firstFrame, unsigned int frameCount);
+
+        /// Writes both indices and moves the file into place.
+        void Close();
+
+        bool IsOpen() const { return file.is_open(); }
+
+        /// Drops all tracks. The next track gets ID 0.
+        void Clear();
+
+        int GetTrackCount() const { return tracks.size(); }
+
+        /// ID of the track of the given object of the last frame.
+        unsigned int GetId(int i) const { return tracks.id[i]; }
+
+        /// Amount of frames that the track of the given object of the last frame has been seen in.
+        unsigned int GetLength(int i) const { return tracks.length[i]; }
+
+        /// Moves all tracks one frame ahead, to be matched against the objects of the next frame.
+        void Predict() { motion.Predict(); }
+
+        /// Motion filters of the tracks, indexed like the tracks.
+        const Tracking::KalmanTracks& GetMotion() const { return motion; }
+
+        /// Assigns the tracks of the objects of a new frame, given the links between the objects of the last frame and them,
+        /// and appends their records to the file (if open). Frames must be given in increasing order.
+        void Update(unsigned int iFrame, const std::vector<std::pair<int, int>>& links, const std::vector<ObjectProfile>& objects);
+    };
+
+    /// Queries of the objects and tracks stored in a track file, without any pixel data. The file is memory-mapped.
+    class TrackFileReader
+    {
+        Util::MappedFile file;
+        const TrackFileHeader* header;
+        const TrackRecord* records;
+        const unsigned int* frameIndex;
+        const TrackIndexEntry* trackIndex;
+
+        /// Disallow copy ctor
+        TrackFileReader(const TrackFileReader&);
+        TrackFileReader& operator=(const TrackFileReader&);
+
+    public:
+        TrackFileReader() :
+            header(nullptr),
+            records(nullptr),
+            frameIndex(nullptr),
+            trackIndex(nullptr)
+        {
+        }
+
+        virtual ~TrackFileReader()
+        {
+            Close();
+        }
+
+        /// Maps the given file. Returns false, if it does not exist, or has not been closed properly.
+        bool Open(const std::string& fname);
+
+        void Close();
+
+        bool IsOpen() const { return header != nullptr; }
+
+        unsigned int GetFirstFrame() const { return header ? header->FirstFrame : 0; }
+        unsigned int GetFrameCount() const { return header ? header->FrameCount : 0; }
+        unsigned int GetTrackCount() const { return header ? header->TrackCount : 0; }
+
+        /// All records of the given frame, ordered by ID. Returns the amount of records (0, if the frame is not stored).
+        int GetFrame(unsigned int iFrame, const TrackRecord*& frameRecords) const;
+
+        /// The record of the given track in the given frame, or nullptr, if the track has no object in that frame.
+        const TrackRecord* FindRecord(unsigned int iFrame, unsigned int id) const;
+
+        /// Life time of the given track, or nullptr, if there is no such track.
+        const TrackIndexEntry* GetTrack(unsigned int id) const;
+
+        /// All frames and records of the given track, in frame order.
+        bool ReadTrack(unsigned int id, std::vector<unsigned int>& frames, std::vector<TrackRecord>& trackRecords) const;
+    };
+}
+
+#endif // TRACKSTORE_H
@@ -104,6 +104,21 @@ namespace Util
         return lines;
     }
 
+    /// Reads the whole given file into the given buffer (re-using its memory). Returns false, if the file could not be read.
+    inline bool ReadBytes(const std::string& fname, std::vector<unsigned char>& buffer)
+    {
+        std::ifstream file(fname, std::ifstream::in | std::ifstream::binary);
+        if (!file) return false;
+
+        file.seekg(0, std::ifstream::end);
+        std::streamoff size = file.tellg();
+        file.seekg(0, std::ifstream::beg);
+        if (size <= 0) return false;
+
+        buffer.resize(static_cast<size_t>(size));
+        return !!file.read(reinterpret_cast<char*>(&buffer[0]), size);
+    }
+
     /// Write the given vector into a text file, each line containing one value.
     template<typename T>
     inline void WriteLines(std::string fname, std::vector<T> values)
@@ -1,4 +1,3 @@
-
 #include "Workers.h"
 #include <cassert>
 #include <numeric>
@@ -7,76 +6,243 @@ using namespace std;
 
 namespace Util
 {
-    bool Worker::IsIdle() const { return !isRunning && !pool.IsStopped(); }
+    Worker::Worker(WorkerPool& pool, int workerId) :
+        workerId(workerId),
+        pool(pool)
+    {
+    }
 
     void Worker::RunLoop()
     {   
-        while (!pool.isStopped)
+        Task task;
+        while (true)
         {
-            while (!pool.isStopped && pool.job && isRunning)
+            if (pool.TakeTask(workerId, task))
+            {
+                task();
+                task = nullptr;
+                pool.FinishTask();
+                continue;
+            }
+
+            // sleep until there is more work
+            unique_lock<mutex> lk(pool.poolLock);
+            pool.wakeCondition.wait(lk, [this]() { return pool.isShutdown || pool.nQueuedTasks.load() > 0; });
+            if (pool.isShutdown && pool.nQueuedTasks.load() == 0)
             {
-                isRunning = pool.job(pool.iNextJobIndex++);
+                return;
             }
-            
-            isRunning = false;
+        }
+    }
+
+    bool Worker::PopTask(Task& task)
+    {
+        unique_lock<mutex> lk(queueLock);
+        if (tasks.empty()) return false;
+
+        task = std::move(tasks.back());
+        tasks.pop_back();
+        return true;
+    }
+
+    bool Worker::StealTask(Task& task)
+    {
+        unique_lock<mutex> lk(queueLock);
+        if (tasks.empty()) return false;
+
+        task = std::move(tasks.front());
+        tasks.pop_front();
+        return true;
+    }
+
+
+    WorkerPool::WorkerPool(int nWorkers) :
+        nQueuedTasks(0),
+        nPendingTasks(0),
+        iNextQueue(0),
+        isStopped(false),
+        isShutdown(false)
+    {
+        if (nWorkers <= 0)
+        {
+            nWorkers = std::thread::hardware_concurrency();
+            if (!nWorkers)
+                nWorkers = NMaxWorkersDefault;           // if the system does not reveal the amount, assign default
+        }
 
-            this_thread::sleep_for(std::chrono::milliseconds(WorkerRunDelayMS));
+        // create all workers before starting any of them, so they can safely steal from each other
+        workers.reserve(nWorkers);
+        for (int i = 0; i < nWorkers; ++i)
+        {
+            workers.push_back(unique_ptr<Worker>(new Worker(*this, i)));
+        }
+        for (auto& worker : workers)
+        {
+            worker->thread = std::thread(std::bind(&Worker::RunLoop, worker.get()));
         }
-        pool.RemoveWorker(*this);
     }
 
+    WorkerPool::~WorkerPool()
+    {
+        Stop();
+        {
+            unique_lock<mutex> lk(poolLock);
+            isShutdown = true;
+        }
+        wakeCondition.notify_all();
+
+        for (auto& worker : workers)
+        {
+            worker->thread.join();
+        }
+    }
 
-    void WorkerPool::RemoveWorker(Worker& worker)
+
+    void WorkerPool::Enqueue(Task task, int iWorker)
     {
+        ++nPendingTasks;
         {
-            // lock while removing
+            Worker& worker = *workers[iWorker];
+            unique_lock<mutex> lk(worker.queueLock);
+            worker.tasks.push_back(std::move(task));
+        }
+        ++nQueuedTasks;
+
+        {
+            // lock, so the notification cannot get lost between a worker's check and wait
             unique_lock<mutex> lk(poolLock);
-            
-            // hack around
-            // Must not use remove() here because that requires a copy operation in the VS 2012 std implementation
-            // and Worker does not support copying.
-            workers.remove_if([&worker, this](const Worker& that) { 
-                if (worker == that)
-                {
-                    --nWorkerCount;
-                    return true;
-                }
-                return false;
-            });
+        }
+        wakeCondition.notify_one();
+    }
 
-            if (nWorkerCount == 0)
+    bool WorkerPool::TakeTask(int iWorker, Task& task)
+    {
+        int nWorkers = GetWorkerCount();
+        if (!workers[iWorker]->PopTask(task))
+        {
+            // steal from the others
+            int i = 1;
+            for (; i < nWorkers; ++i)
             {
-                sleepCondition.notify_all();
+                if (workers[(iWorker + i) % nWorkers]->StealTask(task)) break;
             }
+            if (i == nWorkers) return false;
         }
+        --nQueuedTasks;
+        return true;
     }
 
+    void WorkerPool::FinishTask()
+    {
+        if (--nPendingTasks == 0)
+        {
+            unique_lock<mutex> lk(poolLock);
+            idleCondition.notify_all();
+        }
+    }
 
-    void WorkerPool::AddWorkers(Job job)
+    int WorkerPool::GetCurrentWorkerIndex() const
     {
-        int nWorkers = std::thread::hardware_concurrency();
-        if (!nWorkers)
-            nWorkers  = NMaxWorkersDefault;           // if the system does not reveal the amount, assign default
-        AddWorkers(nWorkers, job);
+        auto id = this_thread::get_id();
+        for (auto& worker : workers)
+        {
+            if (worker->thread.get_id() == id) return worker->workerId;
+        }
+        return -1;
+    }
+
+
+    void WorkerPool::Submit(Task task)
+    {
+        int iWorker = GetCurrentWorkerIndex();
+        if (iWorker < 0)
+        {
+            iWorker = iNextQueue++ % GetWorkerCount();
+        }
+        Enqueue(std::move(task), iWorker);
     }
 
     
-    void WorkerPool::AddWorkers(int nWorkers, Job job)
+    void WorkerPool::RunJob(int nParallel, Job job)
     {
+        isStopped = false;
+
+        // all loops of this job share the index counter
+        auto iNextJobIndex = make_shared<atomic<JobIndex>>(0);
+        nParallel = min(nParallel, GetWorkerCount());
+        for (int i = 0; i < nParallel; ++i)
         {
-            // lock while adding threads and assigning tasks
-            std::unique_lock<std::mutex> lk(poolLock);
-            SetJob(job);
-            isStopped = false;
-            iNextJobIndex.store(0);
+            Submit([this, iNextJobIndex, job]() {
+                while (!isStopped && job((*iNextJobIndex)++));
+            });
+        }
+    }
+
+
+    /// Shared state of one ParallelFor call.
+    struct ParallelForState
+    {
+        RangeTask Body;
+        JobIndex Begin, End, ChunkSize;
+        uint32 NChunks;
+        atomic<uint32> INextChunk;
+        atomic<uint32> NRemainingChunks;
+        mutex DoneLock;
+        condition_variable DoneCondition;
 
-            // Add new workers
-            for (int i = 0; i < nWorkers; ++i)
+        ParallelForState() : INextChunk(0), NRemainingChunks(0) {}
+
+        /// Works on chunks until none are left.
+        void RunChunks()
+        {
+            uint32 iChunk;
+            while ((iChunk = INextChunk++) < NChunks)
             {
-                workers.emplace_front(*this, iNextWorkerId++);
+                JobIndex first = Begin + iChunk * ChunkSize;
+                Body(first, min(first + ChunkSize, End));
+
+                if (--NRemainingChunks == 0)
+                {
+                    unique_lock<mutex> lk(DoneLock);
+                    DoneCondition.notify_all();
+                }
             }
-            nWorkerCount += nWorkers;
         }
+    };
+
+    void WorkerPool::ParallelFor(JobIndex begin, JobIndex end, RangeTask body, JobIndex chunkSize)
+    {
+        if (end <= begin) return;
+
+        int nWorkers = GetWorkerCount();
+        if (chunkSize == 0)
+        {
+            chunkSize = max<JobIndex>(1, (end - begin) / (4 * nWorkers));
+        }
+
+        auto state = make_shared<ParallelForState>();
+        state->Body = body;
+        state->Begin = begin;
+        state->End = end;
+        state->ChunkSize = chunkSize;
+        state->NChunks = (end - begin + chunkSize - 1) / chunkSize;
+        state->NRemainingChunks = state->NChunks;
+
+        // chunks are claimed dynamically, so one helper per worker is enough;
+        // helpers that only start after all chunks have been claimed return immediately
+        int nHelpers = min<int>(nWorkers, state->NChunks - 1);
+        int iCurrentWorker = GetCurrentWorkerIndex();
+        for (int i = 0; i < nHelpers; ++i)
+        {
+            int iWorker = iCurrentWorker < 0 ? iNextQueue++ % nWorkers : (iCurrentWorker + 1 + i) % nWorkers;
+            Enqueue([state]() { state->RunChunks(); }, iWorker);
+        }
+
+        // help out, then wait for chunks that are still being worked on
+        state->RunChunks();
+
+        unique_lock<mutex> lk(state->DoneLock);
+        state->DoneCondition.wait(lk, [&state]() { return state->NRemainingChunks.load() == 0; });
     }
 
 
@@ -88,13 +254,9 @@ namespace Util
 
     void WorkerPool::Join()
     {
-        {
-            // lock for join
-            std::unique_lock<std::mutex> lk(poolLock);
-            if (nWorkerCount > 0)
-            {
-                sleepCondition.wait(lk, [this]() { return nWorkerCount == 0; });
-            }
-        }
+        assert(GetCurrentWorkerIndex() < 0);
+
+        unique_lock<mutex> lk(poolLock);
+        idleCondition.wait(lk, [this]() { return nPendingTasks.load() == 0; });
     }
-}
\ No newline at end of file
+}
@@ -13,75 +13,70 @@
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
-#include <forward_list>
-#include <queue>
+#include <deque>
+#include <vector>
 
 
 namespace Util
 {
     typedef uint32 JobIndex;
 
+    /// A job is run for increasing indices, until it returns false.
     typedef std::function<bool(JobIndex)> Job;
+
+    /// A task is run exactly once.
+    typedef std::function<void()> Task;
+
+    /// Work on the index range [first, last).
+    typedef std::function<void(JobIndex, JobIndex)> RangeTask;
     
     class WorkerPool;
 
-    /// Basic thread wrapper as part of a pool.
+    /// Persistent thread of a pool. Owns a deque of tasks, that other workers can steal from.
     class Worker
     {
-        /// Time to wait periodically while idle (in ms).
-        /// TODO: Use wait/notify instead.
-        static const int WorkerRunDelayMS = 50;
-        
         friend class WorkerPool;
         
-        /// id of this worker
+        /// id of this worker (and index into the pool's worker list)
         int workerId;
-        bool isRunning;
         
         WorkerPool& pool;
+
+        std::mutex queueLock;
+        std::deque<Task> tasks;
+
         std::thread thread;
 
         /// Thread loop.
         void RunLoop();
 
+        /// Takes the most recently added task of this worker.
+        bool PopTask(Task& task);
+
+        /// Takes the oldest task of this worker (called by other threads).
+        bool StealTask(Task& task);
+
         /// Disallow copy ctor
         Worker(const Worker&);
         Worker& operator=(const Worker&);
 
     public:
-        Worker(WorkerPool& pool, int workerId) :
-            workerId(workerId),
-            isRunning(true),        // set to running initially, so Join() won't return immediately
-            pool(pool),
-            thread(std::bind(&Worker::RunLoop, this))
-        {
-            thread.detach();
-        }
-
+        Worker(WorkerPool& pool, int workerId);
 
         virtual ~Worker() 
         {
         }
-
-        bool operator==(const Worker& other)
-        {
-            return other.workerId == workerId;
-        }
         
         /// Unique id assigned to this worker.
         int GetId() const { return workerId; }
-
-        /// Whether this worker is currently running.
-        bool IsRunning() const { return isRunning; }
-
-        /// Whether this worker is hungry for more work.
-        bool IsIdle() const;
     };
 
 
 
 
-    /// A pool of workers to work on one or multiple tasks in parallel.
+    /// A pool of persistent workers to work on one or multiple tasks in parallel.
+    /// Idle workers sleep until new tasks arrive. Every worker has its own task deque, and 
+    /// steals from the other workers' deques when its own is empty.
     class WorkerPool
     {
         friend class Worker;
@@ -89,54 +84,79 @@ namespace Util
         // If the system does not reveal the amount, use this as default.
         static const uint32 NMaxWorkersDefault = 4;
         
+        std::vector<std::unique_ptr<Worker>> workers;
+
         std::mutex poolLock;
-        std::condition_variable sleepCondition;
-        std::atomic<int> iNextWorkerId;
-        std::forward_list<Worker> workers;
-        int nWorkerCount;
-        
-        std::atomic<JobIndex> iNextJobIndex;
-        Job job;
-        bool isStopped;
+        /// Idle workers wait for new tasks
+        std::condition_variable wakeCondition;
+        /// Join waits for all tasks to finish
+        std::condition_variable idleCondition;
+
+        /// Amount of tasks waiting in any deque
+        std::atomic<int> nQueuedTasks;
+        /// Amount of tasks waiting or running
+        std::atomic<int> nPendingTasks;
+        /// Deque to put the next task from a non-worker thread into
+        std::atomic<uint32> iNextQueue;
+
+        std::atomic<bool> isStopped;
+        bool isShutdown;
+
+        /// Disallow copy ctor
+        WorkerPool(const WorkerPool&);
+        WorkerPool& operator=(const WorkerPool&);
+
+        /// Adds the given task to the deque of the given worker and wakes up a sleeping worker.
+        void Enqueue(Task task, int iWorker);
 
-        /// Removes the given worker from this pool.
-        void RemoveWorker(Worker& worker);
+        /// Gets a task from the given worker's deque, or steals one from any other worker.
+        bool TakeTask(int iWorker, Task& task);
+
+        /// Bookkeeping after a task has been run.
+        void FinishTask();
 
     public:
-        WorkerPool() :
-            isStopped(false),
-            nWorkerCount(0)
-        {
-        }
+        /// Starts the given amount of workers (or a system-default amount, if 0).
+        /// Workers keep running until the pool is destroyed.
+        explicit WorkerPool(int nWorkers = 0);
 
-        virtual ~WorkerPool()
-        {
-            Stop();
-            Join();
-        }
+        /// Waits for all queued tasks to finish and disposes all workers.
+        virtual ~WorkerPool();
 
-        /// Whether this pool is stopped. 
-        /// If the pool is stopped, all threads will be disposed at earliest convenience.
-        bool IsStopped() const { return isStopped; }
+        /// Amount of workers in this pool.
+        int GetWorkerCount() const { return static_cast<int>(workers.size()); }
 
-        /// Sets the current task queue and adds a system-default amount of workers.
-        void AddWorkers(Job job);
+        /// Amount of tasks waiting or running.
+        int GetPendingTaskCount() const { return nPendingTasks.load(); }
 
-        /// Sets the current task queue and adds nWorkers.
-        void AddWorkers(int nWorkers, Job job);
-        
-        /// Sets the current task queue
-        void SetJob(Job job) { this->job = job; }
+        /// Index of the worker running on the calling thread (in [0, GetWorkerCount())), or -1.
+        /// Lets tasks keep per-worker state without locking.
+        int GetCurrentWorkerIndex() const;
+
+        /// Whether running jobs have been asked to stop.
+        bool IsStopped() const { return isStopped.load(); }
+
+        /// Runs the given task on any worker.
+        /// When called from a worker of this pool, the task goes into that worker's own deque.
+        void Submit(Task task);
+
+        /// Runs the given job with nParallel concurrent loops (at most one per worker), 
+        /// each calling the job with the next unused index, until it returns false or Stop() is called.
+        void RunJob(int nParallel, Job job);
+
+        /// Runs body on chunks of [begin, end) in parallel and waits until all chunks are done.
+        /// The calling thread works on chunks too, so this can be called from within a task of this pool.
+        /// If chunkSize is 0, the range is split into a few chunks per worker.
+        void ParallelFor(JobIndex begin, JobIndex end, RangeTask body, JobIndex chunkSize = 0);
 
-        /// Stops all threads, clears the worker queue and disposes all threads.
-        /// This call is non-blocking. Call Join to wait for all threads to stop.
-        /// Note: Another call to start will clear the worker queue.
+        /// Asks all running jobs to stop after their current index.
+        /// This call is non-blocking. Call Join to wait for all jobs to stop.
         void Stop();
 
-        /// Wait until all threads in pool are idle or disposed.
+        /// Waits until all tasks and jobs are done. Must not be called from a worker of this pool.
         void Join();
     };
 }
 
 
-#endif // UTIL_WORKER_H
\ No newline at end of file
+#endif // UTIL_WORKER_H